@@ -0,0 +1,67 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+namespace
+{
+    // items per leaf, below this splitting costs more node tests than it saves
+    const unsigned int MAX_LEAF_ITEMS = 4;
+}
+
+void BoundingVolumeHierarchy::Build(const std::vector<AABB>& itemBounds)
+{
+    nodes.clear();
+    items.resize(itemBounds.size());
+    for (unsigned int i = 0; i < items.size(); i++)
+        items[i] = i;
+    if (items.empty())
+        return;
+
+    // a binary tree with n leaves or less has at most 2n - 1 nodes
+    nodes.reserve(2 * items.size());
+    nodes.emplace_back();
+    buildNode(itemBounds, 0, 0, static_cast<unsigned int>(items.size()));
+}
+
+const AABB& BoundingVolumeHierarchy::GetBounds() const
+{
+    static const AABB empty;
+    return nodes.empty() ? empty : nodes[0].bounds;
+}
+
+void BoundingVolumeHierarchy::buildNode(const std::vector<AABB>& itemBounds, unsigned int index, unsigned int first, unsigned int count)
+{
+    AABB bounds, centers;
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        bounds.Expand(itemBounds[items[i]]);
+        centers.Expand(itemBounds[items[i]].GetCenter());
+    }
+    nodes[index].bounds = bounds;
+
+    if (count <= MAX_LEAF_ITEMS)
+    {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        return;
+    }
+
+    // split at the median of the longest axis of the item centers
+    const glm::vec3 size = centers.max - centers.min;
+    const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    const unsigned int half = count / 2;
+    std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+        [&](unsigned int a, unsigned int b) {
+            return itemBounds[a].GetCenter()[axis] < itemBounds[b].GetCenter()[axis];
+        });
+
+    // children are allocated in pairs, the right child always follows the left one
+    const unsigned int left = static_cast<unsigned int>(nodes.size());
+    nodes[index].first = left;
+    nodes[index].count = 0;
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    buildNode(itemBounds, left, first, half);
+    buildNode(itemBounds, left + 1, first + half, count - half);
+}
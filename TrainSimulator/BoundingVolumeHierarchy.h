@@ -0,0 +1,88 @@
+#pragma once
+#ifndef BOUNDING_VOLUME_HIERARCHY_H
+#define BOUNDING_VOLUME_HIERARCHY_H
+
+#include "Bounds.h"
+
+#include <vector>
+
+// Binary tree of bounding boxes over a fixed set of items (the submeshes of a model).
+// Built once at load time by splitting the items at the median of the longest axis; queries skip whole
+// subtrees outside the frustum and accept whole subtrees inside it without testing their items.
+class BoundingVolumeHierarchy
+{
+public:
+    // builds the tree over the items, item i has bounds itemBounds[i]
+    void Build(const std::vector<AABB>& itemBounds);
+
+    // calls visit(item) for every item whose bounds intersect the frustum
+    template <typename Visitor>
+    void Query(const Frustum& frustum, Visitor&& visit) const;
+
+    // bounds of every item
+    const AABB& GetBounds() const;
+
+    size_t GetNodeCount() const { return nodes.size(); }
+
+private:
+    struct Node {
+        AABB bounds;
+        unsigned int first; // leaf: first entry in items, inner node: index of the left child (right child follows it)
+        unsigned int count; // leaf: number of items, 0 for inner nodes
+    };
+
+    // fills the already allocated node index with items[first, first + count), splitting it when it holds too many
+    void buildNode(const std::vector<AABB>& itemBounds, unsigned int index, unsigned int first, unsigned int count);
+
+    template <typename Visitor>
+    void visitAll(const Node& node, Visitor& visit) const;
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> items;
+};
+
+template <typename Visitor>
+void BoundingVolumeHierarchy::Query(const Frustum& frustum, Visitor&& visit) const
+{
+    if (nodes.empty())
+        return;
+
+    unsigned int stack[64];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        const EFrustumTest test = frustum.Test(node.bounds);
+        if (test == EFrustumTest::OUTSIDE)
+            continue;
+        if (test == EFrustumTest::INSIDE)
+        {
+            visitAll(node, visit);
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (unsigned int i = 0; i < node.count; i++)
+                visit(items[node.first + i]);
+            continue;
+        }
+        stack[stackSize++] = node.first;
+        stack[stackSize++] = node.first + 1;
+    }
+}
+
+template <typename Visitor>
+void BoundingVolumeHierarchy::visitAll(const Node& node, Visitor& visit) const
+{
+    if (node.count > 0)
+    {
+        for (unsigned int i = 0; i < node.count; i++)
+            visit(items[node.first + i]);
+        return;
+    }
+    visitAll(nodes[node.first], visit);
+    visitAll(nodes[node.first + 1], visit);
+}
+
+#endif
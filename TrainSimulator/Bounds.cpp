@@ -0,0 +1,80 @@
+#include "Bounds.h"
+
+#include <cmath>
+
+void AABB::Expand(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::Expand(const AABB& other)
+{
+    if (!other.IsValid())
+        return;
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+AABB AABB::Transform(const glm::mat4& transform) const
+{
+    if (!IsValid())
+        return AABB();
+
+    // Arvo's method: transformed center plus the extents projected on the absolute rotation/scale
+    const glm::vec3 center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
+    const glm::vec3 extents = GetExtents();
+    glm::vec3 newExtents(0.0f);
+    for (int column = 0; column < 3; column++)
+        newExtents += glm::abs(glm::vec3(transform[column])) * extents[column];
+
+    AABB result;
+    result.min = center - newExtents;
+    result.max = center + newExtents;
+    return result;
+}
+
+Frustum::Frustum(const glm::mat4& m)
+{
+    // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0; // left
+    planes[1] = row3 - row0; // right
+    planes[2] = row3 + row1; // bottom
+    planes[3] = row3 - row1; // top
+    planes[4] = row3 + row2; // near
+    planes[5] = row3 - row2; // far
+
+    for (glm::vec4& plane : planes)
+    {
+        const float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane /= length;
+    }
+}
+
+EFrustumTest Frustum::Test(const AABB& box) const
+{
+    if (!box.IsValid())
+        return EFrustumTest::OUTSIDE;
+
+    const glm::vec3 center = box.GetCenter();
+    const glm::vec3 extents = box.GetExtents();
+    EFrustumTest result = EFrustumTest::INSIDE;
+    for (const glm::vec4& plane : planes)
+    {
+        const glm::vec3 normal(plane);
+        // signed distance of the center and the projected radius of the box on the plane normal
+        const float distance = glm::dot(normal, center) + plane.w;
+        const float radius = glm::dot(glm::abs(normal), extents);
+        if (distance < -radius)
+            return EFrustumTest::OUTSIDE;
+        if (distance < radius)
+            result = EFrustumTest::INTERSECTS;
+    }
+    return result;
+}
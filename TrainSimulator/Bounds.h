@@ -0,0 +1,48 @@
+#pragma once
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm.hpp>
+
+#include <cfloat>
+
+// axis aligned bounding box, empty (min > max) until a point is added
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+    glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+    // radius of the bounding sphere around the center
+    float GetRadius() const { return glm::length(GetExtents()); }
+
+    void Expand(const glm::vec3& point);
+    void Expand(const AABB& other);
+
+    // bounds of this box after transform (the box around the 8 transformed corners)
+    AABB Transform(const glm::mat4& transform) const;
+};
+
+enum class EFrustumTest {
+    OUTSIDE,
+    INTERSECTS,
+    INSIDE
+};
+
+// the 6 planes of a view-projection matrix (Gribb/Hartmann extraction).
+// built from projection * view * model the planes are in model space, so model space bounds can be tested directly.
+class Frustum
+{
+public:
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    EFrustumTest Test(const AABB& box) const;
+    bool Intersects(const AABB& box) const { return Test(box) != EFrustumTest::OUTSIDE; }
+
+private:
+    glm::vec4 planes[6]; // xyz normal pointing inside, w distance
+};
+
+#endif
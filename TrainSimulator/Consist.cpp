@@ -0,0 +1,79 @@
+#include "Consist.h"
+
+namespace
+{
+	// the locomotive moves a fraction of a unit per step, shorter steps than this are not worth a trail point
+	const float MIN_TRAIL_STEP = 0.25f;
+}
+
+Consist::Consist(unsigned int wagonCount, float spacing) : wagonCount(wagonCount), spacing(spacing)
+{
+}
+
+void Consist::Reset(const TrainPose& head, const glm::vec3& backward)
+{
+	trail.clear();
+	trail.push_back(head);
+	trail.push_back({ head.position + backward * (spacing * (wagonCount + 1)), head.rotation });
+}
+
+void Consist::Advance(const TrainPose& head)
+{
+	if (trail.empty() || glm::distance(trail.front().position, head.position) >= MIN_TRAIL_STEP)
+		trail.push_front(head);
+	else
+		trail.front() = head;
+	trim();
+}
+
+void Consist::GetWagonPoses(std::vector<TrainPose>& poses) const
+{
+	poses.clear();
+	if (trail.empty())
+		return;
+
+	// walk the path from the locomotive, wagon i stands (i + 1) * spacing behind it
+	size_t segment = 0;
+	float segmentStart = 0.0f;
+	for (unsigned int wagon = 0; wagon < wagonCount; wagon++)
+	{
+		const float distance = (wagon + 1) * spacing;
+		while (segment + 1 < trail.size())
+		{
+			const float length = glm::distance(trail[segment].position, trail[segment + 1].position);
+			if (segmentStart + length >= distance)
+				break;
+			segmentStart += length;
+			segment++;
+		}
+
+		if (segment + 1 >= trail.size())
+		{
+			// the path is too short, the remaining wagons wait at its end
+			poses.push_back(trail.back());
+			continue;
+		}
+		const TrainPose& newer = trail[segment];
+		const TrainPose& older = trail[segment + 1];
+		const float length = glm::distance(newer.position, older.position);
+		const float t = length > 0.0f ? (distance - segmentStart) / length : 0.0f;
+		// trail points are close together, the nearer rotation is good enough and avoids blending across 360 degrees
+		poses.push_back({ glm::mix(newer.position, older.position, t), t < 0.5f ? newer.rotation : older.rotation });
+	}
+}
+
+void Consist::trim()
+{
+	// keep the first point beyond the last wagon, everything older is never read again
+	const float needed = (wagonCount + 1) * spacing;
+	float length = 0.0f;
+	for (size_t i = 0; i + 1 < trail.size(); i++)
+	{
+		length += glm::distance(trail[i].position, trail[i + 1].position);
+		if (length >= needed)
+		{
+			trail.resize(i + 2);
+			return;
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef CONSIST_H
+#define CONSIST_H
+
+#include <glm.hpp>
+
+#include <deque>
+#include <vector>
+
+// where a rail vehicle is and how it is turned, rotation in degrees around x, y and z like trainRotation
+struct TrainPose {
+	glm::vec3 position;
+	glm::vec3 rotation;
+};
+
+// The wagons pulled by the locomotive.
+// The consist remembers the path the locomotive took and places every wagon on it, spacing apart, so the wagons
+// follow the track through curves and slopes without knowing anything about it.
+class Consist
+{
+public:
+	Consist(unsigned int wagonCount, float spacing);
+
+	// forgets the path, the wagons line up straight behind head along backward
+	void Reset(const TrainPose& head, const glm::vec3& backward);
+
+	// records where the locomotive is now, call after every move
+	void Advance(const TrainPose& head);
+
+	// pose of every wagon, the first one right behind the locomotive
+	void GetWagonPoses(std::vector<TrainPose>& poses) const;
+
+	unsigned int GetWagonCount() const { return wagonCount; }
+
+private:
+	// drops the part of the path no wagon stands on anymore
+	void trim();
+
+	std::deque<TrainPose> trail; // newest first, trail.front() is the locomotive
+	unsigned int wagonCount;
+	float spacing;
+};
+
+#endif
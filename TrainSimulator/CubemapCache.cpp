@@ -0,0 +1,59 @@
+#include "CubemapCache.h"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <iostream>
+
+CubemapCache::~CubemapCache()
+{
+    for (const auto& cubemap : cubemaps)
+        glDeleteTextures(1, &cubemap.second);
+}
+
+unsigned int CubemapCache::Get(const std::vector<std::string>& faces)
+{
+    auto it = cubemaps.find(faces);
+    if (it != cubemaps.end())
+        return it->second;
+    const unsigned int textureID = load(faces);
+    cubemaps.emplace(faces, textureID);
+    return textureID;
+}
+
+// loads a cubemap texture from 6 individual texture faces
+// order:
+// +X (right)
+// -X (left)
+// +Y (top)
+// -Y (bottom)
+// +Z (front)
+// -Z (back)
+unsigned int CubemapCache::load(const std::vector<std::string>& faces)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    int width, height, nrChannels;
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        // always RGB, so the faces agree on a format whatever the files hold
+        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, STBI_rgb);
+        if (data)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            stbi_image_free(data);
+        }
+        else
+            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    return textureID;
+}
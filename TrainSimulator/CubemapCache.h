@@ -0,0 +1,32 @@
+#pragma once
+#ifndef CUBEMAP_CACHE_H
+#define CUBEMAP_CACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Cubemap textures loaded once and kept for the lifetime of the cache.
+// A cubemap is identified by its six face images (+X, -X, +Y, -Y, +Z, -Z), asking for the same faces again returns
+// the texture loaded the first time, so switching skyboxes is only a texture bind.
+class CubemapCache
+{
+public:
+    CubemapCache() = default;
+    ~CubemapCache();
+
+    CubemapCache(const CubemapCache&) = delete;
+    CubemapCache& operator=(const CubemapCache&) = delete;
+
+    // returns the cubemap of faces, decoding and uploading them the first time. faces that fail to load are left black
+    unsigned int Get(const std::vector<std::string>& faces);
+
+    size_t GetCubemapCount() const { return cubemaps.size(); }
+
+private:
+    static unsigned int load(const std::vector<std::string>& faces);
+
+    std::map<std::vector<std::string>, unsigned int> cubemaps; // owned
+};
+
+#endif
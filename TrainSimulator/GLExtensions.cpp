@@ -0,0 +1,59 @@
+#include "GLExtensions.h"
+
+#include <iostream>
+
+GLExtensions& GLExtensions::Instance()
+{
+	static GLExtensions glExtensions;
+	return glExtensions;
+}
+
+void GLExtensions::Load(GLADloadproc loader)
+{
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	extensions.clear();
+	for (GLint i = 0; i < count; i++)
+		extensions.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+
+	// base instance offsetting instanced attributes in indirect draws is core since 4.2, the indirect draws since 4.3
+	if (HasVersion(4, 3) || (HasExtension("GL_ARB_multi_draw_indirect") && HasExtension("GL_ARB_base_instance")))
+		MultiDrawElementsIndirect = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTPROC>(loader("glMultiDrawElementsIndirect"));
+	multiDrawIndirect = MultiDrawElementsIndirect != nullptr;
+
+	maxAnisotropy = 0.0f;
+	if (HasVersion(4, 6) || HasExtension("GL_EXT_texture_filter_anisotropic") || HasExtension("GL_ARB_texture_filter_anisotropic"))
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+
+	textureCompressionS3TC = HasExtension("GL_EXT_texture_compression_s3tc");
+
+	if (HasVersion(4, 4) || HasExtension("GL_ARB_buffer_storage"))
+		BufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(loader("glBufferStorage"));
+	bufferStorage = BufferStorage != nullptr;
+
+	GLint binaryFormats = 0;
+	if (HasVersion(4, 1) || HasExtension("GL_ARB_get_program_binary"))
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+		GetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(loader("glGetProgramBinary"));
+		ProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(loader("glProgramBinary"));
+		ProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(loader("glProgramParameteri"));
+	}
+	programBinary = binaryFormats > 0 && GetProgramBinary && ProgramBinary && ProgramParameteri;
+
+	std::cout << "OpenGL " << major << "." << minor << ", multi-draw indirect " << (multiDrawIndirect ? "available" : "not available")
+		<< ", anisotropic filtering up to " << maxAnisotropy << "x" << std::endl;
+}
+
+bool GLExtensions::HasVersion(int requiredMajor, int requiredMinor) const
+{
+	return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+}
+
+bool GLExtensions::HasExtension(const std::string& name) const
+{
+	return extensions.count(name) != 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_set>
+
+// enums and entry points newer than the GL 3.3 core glad was generated for
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+// The context version, its extensions and the optional entry points the renderer can use when they are there.
+// Every feature has a flag; code checks the flag and keeps its GL 3.3 path when it is false.
+class GLExtensions
+{
+public:
+	static GLExtensions& Instance();
+
+	// reads the version and extension list of the current context and loads the optional entry points,
+	// call once after glad is loaded
+	void Load(GLADloadproc loader);
+
+	bool HasVersion(int major, int minor) const;
+	bool HasExtension(const std::string& name) const;
+
+	// glMultiDrawElementsIndirect with baseInstance honoured by instanced attributes (GL 4.3 or ARB_multi_draw_indirect)
+	bool multiDrawIndirect = false;
+	PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+
+	// largest GL_TEXTURE_MAX_ANISOTROPY the GPU accepts (GL 4.6 or EXT/ARB_texture_filter_anisotropic), 0 without support
+	float maxAnisotropy = 0.0f;
+
+	// BC1/BC3 textures (EXT_texture_compression_s3tc), BC4/BC5 are core
+	bool textureCompressionS3TC = false;
+
+	// immutable buffers that can stay mapped while the GPU reads them (GL 4.4 or ARB_buffer_storage)
+	bool bufferStorage = false;
+	PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+	// linked programs can be saved and reloaded as driver specific binaries (GL 4.1 or ARB_get_program_binary,
+	// with at least one binary format)
+	bool programBinary = false;
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+private:
+	GLExtensions() = default;
+
+	int major = 0;
+	int minor = 0;
+	std::unordered_set<std::string> extensions;
+};
+
+#endif
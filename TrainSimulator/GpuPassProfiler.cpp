@@ -0,0 +1,50 @@
+#include "GpuPassProfiler.h"
+
+GpuPassProfiler::GpuPassProfiler() : current(0), hasResult(false), milliseconds(0.0), samplesPassed(0)
+{
+	glGenQueries(QUERY_COUNT, timeQueries);
+	glGenQueries(QUERY_COUNT, sampleQueries);
+	for (bool& slot : pending)
+		slot = false;
+}
+
+GpuPassProfiler::~GpuPassProfiler()
+{
+	glDeleteQueries(QUERY_COUNT, timeQueries);
+	glDeleteQueries(QUERY_COUNT, sampleQueries);
+}
+
+void GpuPassProfiler::Begin()
+{
+	// the slot about to be reused holds the oldest measurement, read it first if it is there
+	collect();
+	glBeginQuery(GL_TIME_ELAPSED, timeQueries[current]);
+	glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[current]);
+}
+
+void GpuPassProfiler::End()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = (current + 1) % QUERY_COUNT;
+}
+
+void GpuPassProfiler::collect()
+{
+	if (!pending[current])
+		return;
+
+	GLint available = 0;
+	glGetQueryObjectiv(sampleQueries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return; // still in flight, try again when the slot comes around
+
+	GLuint64 elapsed = 0, samples = 0;
+	glGetQueryObjectui64v(timeQueries[current], GL_QUERY_RESULT, &elapsed);
+	glGetQueryObjectui64v(sampleQueries[current], GL_QUERY_RESULT, &samples);
+	milliseconds = elapsed / 1000000.0;
+	samplesPassed = samples;
+	hasResult = true;
+	pending[current] = false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef GPU_PASS_PROFILER_H
+#define GPU_PASS_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Measures a pass on the GPU with a GL_TIME_ELAPSED and a GL_SAMPLES_PASSED query.
+// Every frame uses its own pair of queries from a small ring and results are only read once the driver reports
+// them available, so measuring never stalls the pipeline; the values lag a few frames behind.
+class GpuPassProfiler
+{
+public:
+	GpuPassProfiler();
+	~GpuPassProfiler();
+
+	GpuPassProfiler(const GpuPassProfiler&) = delete;
+	GpuPassProfiler& operator=(const GpuPassProfiler&) = delete;
+
+	// wraps the GL calls of the pass, at most once per frame. queries of the same target can't be nested
+	void Begin();
+	void End();
+
+	// true once a result was read back
+	bool HasResult() const { return hasResult; }
+
+	// GPU time of the pass in milliseconds
+	double GetMilliseconds() const { return milliseconds; }
+
+	// samples that passed the depth test during the pass, the fragments that were shaded
+	uint64_t GetSamplesPassed() const { return samplesPassed; }
+
+private:
+	static const unsigned int QUERY_COUNT = 4;
+
+	// reads the oldest pair if the driver has it, without waiting
+	void collect();
+
+	unsigned int timeQueries[QUERY_COUNT];
+	unsigned int sampleQueries[QUERY_COUNT];
+	bool pending[QUERY_COUNT];
+	unsigned int current;
+
+	bool hasResult;
+	double milliseconds;
+	uint64_t samplesPassed;
+};
+
+#endif
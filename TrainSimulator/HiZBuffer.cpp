@@ -0,0 +1,196 @@
+#include "HiZBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+HiZBuffer::HiZBuffer(unsigned int screenWidth, unsigned int screenHeight, unsigned int width, unsigned int height) :
+	screenWidth(screenWidth), screenHeight(screenHeight), width(width), height(height),
+	reduceShader("HiZReduce.vs", "HiZReduce.fs"), writeSlot(0), viewProjection(1.0f), ready(false)
+{
+	// the blit source is the default framebuffer, whose depth buffer is 24 bit depth + 8 bit stencil
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, screenWidth, screenHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	glGenFramebuffers(1, &depthFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	glGenTextures(1, &reduceTexture);
+	glBindTexture(GL_TEXTURE_2D, reduceTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glGenFramebuffers(1, &reduceFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, reduceFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reduceTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::HIZ_BUFFER:: reduction framebuffer is not complete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenVertexArrays(1, &emptyVAO);
+
+	glGenBuffers(READBACK_COUNT, pixelBuffers);
+	for (unsigned int i = 0; i < READBACK_COUNT; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width * height * sizeof(float), NULL, GL_STREAM_READ);
+		fences[i] = nullptr;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	levels.resize(1 + static_cast<size_t>(std::log2(std::max(width, height))));
+	for (size_t level = 0; level < levels.size(); level++)
+		levels[level].resize(std::max(width >> level, 1u) * std::max(height >> level, 1u), 1.0f);
+
+	reduceShader.Use();
+	reduceShader.SetInt("depthTexture", 0);
+	glUniform2i(reduceShader.GetUniformLocation("sourceSize"), screenWidth, screenHeight);
+	glUniform2i(reduceShader.GetUniformLocation("targetSize"), width, height);
+}
+
+HiZBuffer::~HiZBuffer()
+{
+	for (GLsync fence : fences)
+		if (fence)
+			glDeleteSync(fence);
+	glDeleteBuffers(READBACK_COUNT, pixelBuffers);
+	glDeleteVertexArrays(1, &emptyVAO);
+	glDeleteFramebuffers(1, &reduceFBO);
+	glDeleteTextures(1, &reduceTexture);
+	glDeleteFramebuffers(1, &depthFBO);
+	glDeleteTextures(1, &depthTexture);
+}
+
+void HiZBuffer::Update(const glm::mat4& currentViewProjection)
+{
+	// 1. copy the depth buffer, a blit is the only way to read the depth of the default framebuffer
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFBO);
+	glBlitFramebuffer(0, 0, screenWidth, screenHeight, 0, 0, screenWidth, screenHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	// 2. reduce it to the small buffer, keeping the farthest depth of every covered block
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	const GLboolean blend = glIsEnabled(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, reduceFBO);
+	glViewport(0, 0, width, height);
+	reduceShader.Use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glBindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	// 3. start the readback into the next pixel buffer, the data is only touched once its fence signals
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[writeSlot]);
+	glReadPixels(0, 0, width, height, GL_RED, GL_FLOAT, NULL);
+	if (fences[writeSlot])
+		glDeleteSync(fences[writeSlot]);
+	fences[writeSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slotViewProjections[writeSlot] = currentViewProjection;
+	writeSlot = (writeSlot + 1) % READBACK_COUNT;
+
+	// 4. the oldest slot was written READBACK_COUNT - 1 frames ago, use it if the GPU is done (never wait for it)
+	GLsync& oldest = fences[writeSlot];
+	if (oldest && glClientWaitSync(oldest, 0, 0) != GL_TIMEOUT_EXPIRED)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[writeSlot]);
+		const float* depth = static_cast<const float*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, width * height * sizeof(float), GL_MAP_READ_BIT));
+		if (depth)
+		{
+			buildPyramid(depth);
+			viewProjection = slotViewProjections[writeSlot];
+			ready = true;
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glDeleteSync(oldest);
+		oldest = nullptr;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, screenWidth, screenHeight);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+	if (blend)
+		glEnable(GL_BLEND);
+}
+
+void HiZBuffer::buildPyramid(const float* depth)
+{
+	std::copy(depth, depth + levels[0].size(), levels[0].begin());
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const unsigned int sourceWidth = std::max(width >> (level - 1), 1u);
+		const unsigned int sourceHeight = std::max(height >> (level - 1), 1u);
+		const unsigned int levelWidth = std::max(width >> level, 1u);
+		const unsigned int levelHeight = std::max(height >> level, 1u);
+		const std::vector<float>& source = levels[level - 1];
+		std::vector<float>& target = levels[level];
+		for (unsigned int y = 0; y < levelHeight; y++)
+		{
+			const unsigned int y0 = std::min(2 * y, sourceHeight - 1), y1 = std::min(2 * y + 1, sourceHeight - 1);
+			for (unsigned int x = 0; x < levelWidth; x++)
+			{
+				const unsigned int x0 = std::min(2 * x, sourceWidth - 1), x1 = std::min(2 * x + 1, sourceWidth - 1);
+				target[y * levelWidth + x] = std::max(std::max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+					std::max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+			}
+		}
+	}
+}
+
+bool HiZBuffer::IsOccluded(const AABB& worldBounds) const
+{
+	if (!ready || !worldBounds.IsValid())
+		return false;
+
+	// screen rectangle and nearest depth of the box, as seen by the camera the pyramid was rendered with
+	glm::vec2 minUV(FLT_MAX), maxUV(-FLT_MAX);
+	float nearestDepth = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const glm::vec3 point((corner & 1) ? worldBounds.max.x : worldBounds.min.x,
+			(corner & 2) ? worldBounds.max.y : worldBounds.min.y,
+			(corner & 4) ? worldBounds.max.z : worldBounds.min.z);
+		const glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+		// crossing the near plane, the projection is meaningless and the camera may be inside the box
+		if (clip.w <= 1e-5f)
+			return false;
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		minUV = glm::min(minUV, glm::vec2(ndc) * 0.5f + 0.5f);
+		maxUV = glm::max(maxUV, glm::vec2(ndc) * 0.5f + 0.5f);
+		nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+	}
+	// off screen for that camera, nothing is known about it
+	if (maxUV.x < 0.0f || maxUV.y < 0.0f || minUV.x > 1.0f || minUV.y > 1.0f)
+		return false;
+	minUV = glm::clamp(minUV, 0.0f, 1.0f);
+	maxUV = glm::clamp(maxUV, 0.0f, 1.0f);
+
+	// pick the level where the rectangle covers at most 2x2 texels
+	int x0 = std::min(static_cast<int>(minUV.x * width), static_cast<int>(width) - 1);
+	int y0 = std::min(static_cast<int>(minUV.y * height), static_cast<int>(height) - 1);
+	int x1 = std::min(static_cast<int>(maxUV.x * width), static_cast<int>(width) - 1);
+	int y1 = std::min(static_cast<int>(maxUV.y * height), static_cast<int>(height) - 1);
+	size_t level = 0;
+	while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	const int levelWidth = std::max(static_cast<int>(width >> level), 1);
+	const int levelHeight = std::max(static_cast<int>(height >> level), 1);
+	float farthestDepth = 0.0f;
+	for (int y = y0 >> level; y <= std::min(y1 >> static_cast<int>(level), levelHeight - 1); y++)
+		for (int x = x0 >> level; x <= std::min(x1 >> static_cast<int>(level), levelWidth - 1); x++)
+			farthestDepth = std::max(farthestDepth, levels[level][y * levelWidth + x]);
+
+	return nearestDepth > farthestDepth;
+}
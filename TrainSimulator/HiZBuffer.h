@@ -0,0 +1,67 @@
+#pragma once
+#ifndef HI_Z_BUFFER_H
+#define HI_Z_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include "Bounds.h"
+#include "Shader.h"
+
+#include <vector>
+
+// Hierarchical depth buffer for occlusion culling on the CPU.
+// After the main pass the depth of the default framebuffer is copied, reduced on the GPU (max depth) to a small
+// power of two buffer and read back through a ring of pixel buffers, so the CPU never waits for the GPU.
+// When a readback arrives the CPU builds the rest of the max-depth mip chain and keeps the view-projection the
+// depth was rendered with; boxes are tested against that (a couple of frames old) pyramid.
+class HiZBuffer
+{
+public:
+	HiZBuffer(unsigned int screenWidth, unsigned int screenHeight, unsigned int width = 256, unsigned int height = 128);
+	~HiZBuffer();
+
+	HiZBuffer(const HiZBuffer&) = delete;
+	HiZBuffer& operator=(const HiZBuffer&) = delete;
+
+	// captures the depth of the default framebuffer rendered with viewProjection and collects finished readbacks.
+	// call after the opaque geometry of the main pass is drawn
+	void Update(const glm::mat4& viewProjection);
+
+	// true once a readback arrived, before that every test reports visible
+	bool IsReady() const { return ready; }
+
+	// forgets the current pyramid, for when it stopped being updated for a while
+	void Invalidate() { ready = false; }
+
+	// true when the world space box is behind the depth of the pyramid everywhere it covers
+	bool IsOccluded(const AABB& worldBounds) const;
+
+private:
+	static const unsigned int READBACK_COUNT = 3;
+
+	// copies a finished readback into level 0 and rebuilds the other levels
+	void buildPyramid(const float* depth);
+
+	unsigned int screenWidth, screenHeight;
+	unsigned int width, height;
+
+	// GPU side: full resolution depth copy and the reduced buffer
+	unsigned int depthFBO, depthTexture;
+	unsigned int reduceFBO, reduceTexture;
+	unsigned int emptyVAO;
+	Shader reduceShader;
+
+	// readback ring, each slot remembers the matrix its depth was rendered with
+	unsigned int pixelBuffers[READBACK_COUNT];
+	GLsync fences[READBACK_COUNT];
+	glm::mat4 slotViewProjections[READBACK_COUNT];
+	unsigned int writeSlot;
+
+	// CPU pyramid, level i is (width >> i) x (height >> i)
+	std::vector<std::vector<float>> levels;
+	glm::mat4 viewProjection;
+	bool ready;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) out float maxDepth;
+
+uniform sampler2D depthTexture;
+uniform ivec2 sourceSize;
+uniform ivec2 targetSize;
+
+// every target texel keeps the farthest depth of the source texels it covers, so the
+// reduced buffer never claims something is hidden when one of its source texels says otherwise
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 begin = texel * sourceSize / targetSize;
+    ivec2 end = min(((texel + 1) * sourceSize + targetSize - 1) / targetSize, sourceSize);
+
+    float depth = 0.0;
+    for (int y = begin.y; y < end.y; y++)
+        for (int x = begin.x; x < end.x; x++)
+            depth = max(depth, texelFetch(depthTexture, ivec2(x, y), 0).r);
+    maxDepth = depth;
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+// fullscreen triangle from the vertex id, drawn without vertex buffers
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,239 @@
+#include "IndirectRenderer.h"
+
+#include "GLExtensions.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_set>
+
+namespace
+{
+	GLsizeiptr GetBufferSize(unsigned int buffer)
+	{
+		GLint size = 0;
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+		return size;
+	}
+
+}
+
+IndirectRenderer::IndirectRenderer(std::vector<SceneObject>& objects) : slotCount(0)
+{
+	// pick the objects first: the arena holds one vertex layout, the slots one matrix per submesh (so a model placed twice stays
+	// on the regular path) and the INSTANCED programs transform normals with mat3(model), which needs uniform scale
+	std::vector<SceneObject*> accepted;
+	std::unordered_set<const Model*> models;
+	bool hasLayout = false;
+	for (SceneObject& object : objects)
+	{
+		if (!object.model || object.model->meshes.empty() || object.dynamic || object.instanced || !HasUniformScale(object.transform) ||
+			models.count(object.model))
+			continue;
+		const VertexLayout& objectLayout = object.model->meshes[0].layout;
+		bool sameLayout = !hasLayout || objectLayout == layout;
+		for (const Mesh& mesh : object.model->meshes)
+			sameLayout = sameLayout && mesh.layout == objectLayout;
+		if (!sameLayout)
+			continue;
+		layout = objectLayout;
+		hasLayout = true;
+		models.insert(object.model);
+		accepted.push_back(&object);
+	}
+
+	// every submesh samples a layer of a texture array instead of its own texture
+	for (SceneObject* object : accepted)
+		for (Mesh& mesh : object->model->meshes)
+			packer.Add(mesh);
+	packer.Pack();
+
+	// place every mesh in the arena and give each submesh a slot
+	GLsizeiptr vertexBytes = 0, indexBytes = 0;
+	std::vector<glm::mat4> slots;
+	std::vector<float> slotLayers;
+	for (SceneObject* object : accepted)
+	{
+		for (Mesh& mesh : object->model->meshes)
+		{
+			MeshRange range;
+			range.baseVertex = static_cast<GLint>(vertexBytes / layout.GetStride());
+			range.firstIndex = static_cast<GLuint>(indexBytes / sizeof(unsigned int));
+			range.firstSlot = static_cast<GLuint>(slots.size());
+			ranges[&mesh] = range;
+			vertexBytes += GetBufferSize(mesh.GetVertexBuffer());
+			indexBytes += GetBufferSize(mesh.GetIndexBuffer());
+			slots.insert(slots.end(), mesh.subMeshes.size(), object->transform);
+			for (const SubMesh& subMesh : mesh.subMeshes)
+				slotLayers.push_back(static_cast<float>(subMesh.diffuseLayer.layer));
+		}
+		object->indirect = true;
+	}
+	slotCount = slots.size();
+
+	// copy the buffers on the GPU, the meshes released their CPU data after the upload
+	glGenBuffers(1, &vertexBuffer);
+	glGenBuffers(1, &indexBuffer);
+	glGenBuffers(1, &slotBuffer);
+	glGenBuffers(1, &layerBuffer);
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+	for (const auto& entry : ranges)
+	{
+		const Mesh& mesh = *entry.first;
+		const MeshRange& range = entry.second;
+		const GLsizeiptr meshVertexBytes = GetBufferSize(mesh.GetVertexBuffer());
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, static_cast<GLintptr>(range.baseVertex) * layout.GetStride(), meshVertexBytes);
+		const GLsizeiptr meshIndexBytes = GetBufferSize(mesh.GetIndexBuffer());
+		glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, static_cast<GLintptr>(range.firstIndex) * sizeof(unsigned int), meshIndexBytes);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, slotBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, slots.size() * sizeof(glm::mat4), slots.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, layerBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, slotLayers.size() * sizeof(float), slotLayers.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	// one VAO for the whole arena, the slot matrices are an instanced attribute offset by baseInstance
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	layout.SetupAttributes();
+	glBindBuffer(GL_ARRAY_BUFFER, slotBuffer);
+	VertexLayout::SetupInstanceAttributes(0);
+	glBindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+	VertexLayout::SetupInstanceLayers(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the arena and the arrays hold copies of the geometry and of the 2D textures, drop those no regular draw needs anymore
+	for (SceneObject* object : accepted)
+	{
+		Model& model = *object->model;
+		const bool shared = std::any_of(objects.begin(), objects.end(), [&](const SceneObject& other) {
+			return other.model == &model && !other.indirect;
+		});
+		if (shared)
+			continue;
+		for (Mesh& mesh : model.meshes)
+		{
+			mesh.ReleaseGpuBuffers();
+			for (SubMesh& subMesh : mesh.subMeshes)
+			{
+				subMesh.textures.clear();
+				subMesh.samplerNames.clear();
+			}
+		}
+		model.textures_loaded.clear();
+	}
+
+	std::cout << "Indirect arena: " << accepted.size() << " objects, " << ranges.size() << " meshes, " << slotCount << " draw slots, "
+		<< (vertexBytes + indexBytes) / (1024 * 1024) << " MB" << std::endl;
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	glDeleteBuffers(1, &slotBuffer);
+	glDeleteBuffers(1, &layerBuffer);
+	glDeleteBuffers(1, &commandBuffer);
+}
+
+void IndirectRenderer::Build(const RenderQueue& queue)
+{
+	for (std::vector<PendingCommand>& list : pending)
+		list.clear();
+
+	for (const DrawPacket& packet : queue.GetPackets())
+	{
+		if (packet.drawClass != DRAW_INDIRECT)
+			continue;
+		auto it = ranges.find(packet.mesh);
+		if (it == ranges.end())
+			continue;
+		const MeshRange& range = it->second;
+		for (unsigned int pass = 0; pass <= MAX_SHADOW_CASCADES; pass++)
+		{
+			if ((packet.passMask & (1u << pass)) == 0)
+				continue;
+			for (unsigned int i = packet.firstSubMesh; i < packet.firstSubMesh + packet.subMeshCount; i++)
+			{
+				const SubMesh& subMesh = packet.mesh->subMeshes[i];
+				PendingCommand pendingCommand;
+				pendingCommand.command = { subMesh.indexCount, 1, range.firstIndex + subMesh.firstIndex, range.baseVertex, range.firstSlot + i };
+				pendingCommand.array = subMesh.diffuseLayer.array;
+				pending[pass].push_back(pendingCommand);
+			}
+		}
+	}
+
+	// every pass is a contiguous range of the command buffer, sorted by texture array so each run binds one array
+	commands.clear();
+	for (unsigned int pass = 0; pass <= MAX_SHADOW_CASCADES; pass++)
+	{
+		std::vector<PendingCommand>& list = pending[pass];
+		std::stable_sort(list.begin(), list.end(), [](const PendingCommand& a, const PendingCommand& b) {
+			return a.array < b.array;
+		});
+
+		PassCommands& passCommands = passes[pass];
+		passCommands.firstCommand = commands.size();
+		passCommands.commandCount = static_cast<GLsizei>(list.size());
+		passCommands.runs.clear();
+		for (const PendingCommand& pendingCommand : list)
+		{
+			if (passCommands.runs.empty() || passCommands.runs.back().array != pendingCommand.array)
+				passCommands.runs.push_back({ pendingCommand.array, commands.size(), 0 });
+			passCommands.runs.back().commandCount++;
+			commands.push_back(pendingCommand.command);
+		}
+	}
+
+	// orphan last frame's commands, the driver hands out fresh memory instead of waiting for the GPU
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void IndirectRenderer::Submit(ERenderPass pass, Shader& shader, bool bindMaterials) const
+{
+	const PassCommands& passCommands = passes[getPassIndex(pass)];
+	if (passCommands.commandCount == 0)
+		return;
+
+	const GLExtensions& gl = GLExtensions::Instance();
+	shader.Use();
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	if (!bindMaterials)
+		gl.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(passCommands.firstCommand * sizeof(DrawElementsIndirectCommand)),
+			passCommands.commandCount, 0);
+	else
+	{
+		glActiveTexture(GL_TEXTURE0);
+		for (const ArrayRun& run : passCommands.runs)
+		{
+			glBindTexture(GL_TEXTURE_2D_ARRAY, run.array);
+			gl.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(run.firstCommand * sizeof(DrawElementsIndirectCommand)),
+				run.commandCount, 0);
+		}
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+unsigned int IndirectRenderer::getPassIndex(ERenderPass pass)
+{
+	unsigned int index = 0;
+	while (index < MAX_SHADOW_CASCADES && (pass & (1u << index)) == 0)
+		index++;
+	return index;
+}
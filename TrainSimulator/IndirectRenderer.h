@@ -0,0 +1,93 @@
+#pragma once
+#ifndef INDIRECT_RENDERER_H
+#define INDIRECT_RENDERER_H
+
+#include <glad/glad.h>
+
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "TexturePacker.h"
+#include "VertexLayout.h"
+
+#include <unordered_map>
+#include <vector>
+
+// Draws static geometry with glMultiDrawElementsIndirect (needs GLExtensions::multiDrawIndirect).
+// The meshes of every static object are copied once into a shared vertex/index arena and their textures into texture
+// arrays. Each submesh gets a draw slot holding the model matrix of its object and the layer of its texture, read by
+// the INDIRECT programs through baseInstance. Every frame the culled packets of those meshes become indirect commands,
+// and a pass costs one multi-draw (one per texture array when it binds textures) instead of a loop of draw calls.
+class IndirectRenderer
+{
+public:
+	// takes the static, uniformly scaled objects whose meshes share one vertex layout and marks them indirect.
+	// their transforms must be final, the draw slots are uploaded once. the mesh buffers and 2D textures of models only
+	// drawn here are released once they are copied into the arena and packed
+	explicit IndirectRenderer(std::vector<SceneObject>& objects);
+	~IndirectRenderer();
+
+	IndirectRenderer(const IndirectRenderer&) = delete;
+	IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+	// turns the DRAW_INDIRECT packets of the sorted queue into commands for every pass and uploads them
+	void Build(const RenderQueue& queue);
+
+	// draws the commands of pass with shader, an INDIRECT program. bindMaterials = false issues a single multi-draw
+	void Submit(ERenderPass pass, Shader& shader, bool bindMaterials) const;
+
+	size_t GetMeshCount() const { return ranges.size(); }
+	size_t GetSlotCount() const { return slotCount; }
+	size_t GetTextureArrayCount() const { return packer.GetArrayCount(); }
+
+private:
+	// layout of a command in GL_DRAW_INDIRECT_BUFFER, fixed by the GL spec
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint  baseVertex;
+		GLuint baseInstance; // draw slot, selects the model matrix
+	};
+
+	// where a mesh landed in the arena
+	struct MeshRange {
+		GLint  baseVertex;
+		GLuint firstIndex;
+		GLuint firstSlot;
+	};
+
+	// consecutive commands of a pass sampling the same texture array
+	struct ArrayRun {
+		unsigned int array;
+		size_t  firstCommand;
+		GLsizei commandCount;
+	};
+
+	// a command waiting to be sorted by texture array
+	struct PendingCommand {
+		DrawElementsIndirectCommand command;
+		unsigned int array;
+	};
+
+	struct PassCommands {
+		size_t firstCommand = 0;
+		GLsizei commandCount = 0;
+		std::vector<ArrayRun> runs;
+	};
+
+	// position of pass in the passes array
+	static unsigned int getPassIndex(ERenderPass pass);
+
+	unsigned int VAO;
+	unsigned int vertexBuffer, indexBuffer, slotBuffer, layerBuffer, commandBuffer;
+	TexturePacker packer;
+	VertexLayout layout;
+	size_t slotCount;
+	std::unordered_map<const Mesh*, MeshRange> ranges;
+	std::vector<PendingCommand> pending[MAX_SHADOW_CASCADES + 1]; // reused by every Build
+	std::vector<DrawElementsIndirectCommand> commands;
+	PassCommands passes[MAX_SHADOW_CASCADES + 1]; // cascades, then the main pass
+};
+
+#endif
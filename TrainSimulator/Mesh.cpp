@@ -1,53 +1,165 @@
 #include "Mesh.h"
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+#include <algorithm>
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, const VertexLayout& layout, bool keepCpuData)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    // a regular mesh is a single range covering the whole index buffer
+    SubMesh subMesh;
+    subMesh.firstIndex = 0;
+    subMesh.indexCount = static_cast<unsigned int>(indices.size());
+    subMesh.materialIndex = 0;
+    subMesh.textures = std::move(textures);
+
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->subMeshes.push_back(std::move(subMesh));
+    this->layout = layout;
+
+    assignSamplerNames();
+    computeBounds();
 
     // now that we have all the required data, set the vertex buffers and its attribute pointers.
-    setupMesh();
+    setupMesh(keepCpuData);
+}
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<SubMesh> subMeshes, const VertexLayout& layout, bool keepCpuData)
+{
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->subMeshes = std::move(subMeshes);
+    this->layout = layout;
+
+    assignSamplerNames();
+    computeBounds();
+    setupMesh(keepCpuData);
 }
 
 void Mesh::Draw(Shader& shader)
+{
+    DrawSubMeshes(shader, 0, subMeshes.size());
+    glBindVertexArray(0);
+
+    // always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawSubMeshes(Shader& shader, size_t firstSubMesh, size_t count, bool bindMaterials)
+{
+    glBindVertexArray(VAO);
+    drawRanges(shader, firstSubMesh, count, bindMaterials, 0);
+}
+
+void Mesh::DrawSubMeshesInstanced(Shader& shader, size_t firstSubMesh, size_t count, unsigned int instanceBuffer, size_t instanceOffset,
+    unsigned int instanceCount, bool bindMaterials)
+{
+    glBindVertexArray(VAO);
+    // GL 3.3 has no base instance, the instance range is selected by moving the attribute pointers instead
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    VertexLayout::SetupInstanceAttributes(instanceOffset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    drawRanges(shader, firstSubMesh, count, bindMaterials, instanceCount);
+}
+
+void Mesh::ReleaseGpuBuffers()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+}
+
+void Mesh::drawRanges(Shader& shader, size_t firstSubMesh, size_t count, bool bindMaterials, unsigned int instanceCount)
+{
+    // submeshes are sorted by material: textures are only rebound when the material changes, and
+    // neighbouring ranges with the same material are drawn with a single call
+    const size_t end = std::min(firstSubMesh + count, subMeshes.size());
+    unsigned int boundMaterial = 0;
+    bool texturesBound = !bindMaterials;
+    for (size_t i = firstSubMesh; i < end;)
+    {
+        const SubMesh& first = subMeshes[i];
+        unsigned int indexCount = first.indexCount;
+        size_t next = i + 1;
+        while (next < end && subMeshes[next].materialIndex == first.materialIndex &&
+            subMeshes[next].firstIndex == first.firstIndex + indexCount)
+        {
+            indexCount += subMeshes[next].indexCount;
+            next++;
+        }
+
+        if (!texturesBound || boundMaterial != first.materialIndex)
+        {
+            bindTextures(shader, first);
+            boundMaterial = first.materialIndex;
+            texturesBound = true;
+        }
+
+        // draw mesh
+        if (instanceCount > 0)
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)(first.firstIndex * sizeof(unsigned int)), instanceCount);
+        else
+            glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)(first.firstIndex * sizeof(unsigned int)));
+        i = next;
+    }
+}
+
+void Mesh::computeBounds()
+{
+    bounds = AABB();
+    for (SubMesh& subMesh : subMeshes)
+    {
+        subMesh.bounds = AABB();
+        const size_t end = std::min<size_t>(subMesh.firstIndex + subMesh.indexCount, indices.size());
+        for (size_t i = subMesh.firstIndex; i < end; i++)
+            subMesh.bounds.Expand(vertices[indices[i]].Position);
+        bounds.Expand(subMesh.bounds);
+    }
+}
+
+void Mesh::assignSamplerNames()
+{
+    for (SubMesh& subMesh : subMeshes)
+    {
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr = 1;
+        unsigned int heightNr = 1;
+        subMesh.samplerNames.clear();
+        for (const Texture& texture : subMesh.textures)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            string number;
+            const string& name = texture.type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to string
+            else if (name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to string
+            else if (name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to string
+            subMesh.samplerNames.push_back(name + number);
+        }
+    }
+}
+
+void Mesh::bindTextures(Shader& shader, const SubMesh& subMesh)
 {
     // bind appropriate textures
-    unsigned int diffuseNr = 1;
-    unsigned int specularNr = 1;
-    unsigned int normalNr = 1;
-    unsigned int heightNr = 1;
-    for (unsigned int i = 0; i < textures.size(); i++)
+    for (unsigned int i = 0; i < subMesh.textures.size(); i++)
     {
         glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-        // retrieve texture number (the N in diffuse_textureN)
-        string number;
-        string name = textures[i].type;
-        if (name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
-        else if (name == "texture_specular")
-            number = std::to_string(specularNr++); // transfer unsigned int to string
-        else if (name == "texture_normal")
-            number = std::to_string(normalNr++); // transfer unsigned int to string
-        else if (name == "texture_height")
-            number = std::to_string(heightNr++); // transfer unsigned int to string
-
-        // now set the sampler to the correct texture unit
-        glUniform1i(glGetUniformLocation(shader.GetID(), (name + number).c_str()), i);
+        // now set the sampler to the correct texture unit, if the shader uses it (the location comes from the shader's cache)
+        int location = shader.FindUniformLocation(subMesh.samplerNames[i]);
+        if (location >= 0)
+            glUniform1i(location, i);
         // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        glBindTexture(GL_TEXTURE_2D, subMesh.textures[i].id);
     }
-
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
 }
 
-void Mesh::setupMesh()
+void Mesh::setupMesh(bool keepCpuData)
 {
     // create buffers/arrays
     glGenVertexArrays(1, &VAO);
@@ -57,36 +169,27 @@ void Mesh::setupMesh()
     glBindVertexArray(VAO);
     // load data into vertex buffers
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for all its items.
-    // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-    // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    // the vertices are packed according to the mesh layout; for the full layout this is the Vertex array itself,
+    // otherwise unused attributes are dropped and normals/texture coordinates may be quantized.
+    if (layout.IsFull())
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    else
+    {
+        vector<unsigned char> vertexData = layout.Pack(vertices);
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+    }
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-    // ids
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-    // weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+    layout.SetupAttributes();
     glBindVertexArray(0);
+
+    // the GPU has its own copy now, release ours unless the caller still needs it
+    if (!keepCpuData)
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
 }
\ No newline at end of file
@@ -7,33 +7,83 @@
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
+#include "Bounds.h"
 #include "Shader.h"
 #include "Texture.h"
 #include "Vertex.h"
+#include "VertexLayout.h"
 
 #include <string>
 #include <vector>
 using namespace std;
 
+// a range of the mesh index buffer drawn with one material
+struct SubMesh {
+    unsigned int    firstIndex;
+    unsigned int    indexCount;
+    unsigned int    materialIndex; // submeshes with the same material index share their textures
+    vector<Texture> textures;
+    vector<string>  samplerNames;  // sampler uniform of each texture (texture_diffuseN, ...), filled by Mesh
+    AABB            bounds;        // model space bounds of the vertices the range uses, filled by Mesh
+    TextureLayer    diffuseLayer;  // copy of the first texture in a texture array, once TexturePacker packed the mesh
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data, vertices and indices are only kept on the CPU after the upload when keepCpuData was requested
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
-    vector<Texture>      textures;
+    vector<SubMesh>      subMeshes;
+    VertexLayout         layout;
+    AABB                 bounds; // model space bounds of every submesh, computed before the CPU data is released
     unsigned int VAO;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
+    // constructor, takes ownership of the data (pass it with std::move to avoid copies).
+    // layout selects which attributes are uploaded and how they are packed, keepCpuData keeps vertices/indices
+    // around after the upload for code that needs the geometry (picking, collisions).
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, const VertexLayout& layout = VertexLayout::Full(), bool keepCpuData = false);
+
+    // constructor for merged geometry: several ranges of one vertex/index buffer, each with its own material.
+    // submeshes should be sorted by material so neighbouring ranges can be drawn together.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<SubMesh> subMeshes, const VertexLayout& layout = VertexLayout::Full(), bool keepCpuData = false);
 
     // render the mesh
     void Draw(Shader& shader);
 
+    // renders count submeshes starting at first, leaving the VAO bound for the next call (the caller unbinds it).
+    // bindMaterials = false skips the textures, for passes that don't sample them or when they are already bound.
+    void DrawSubMeshes(Shader& shader, size_t first, size_t count, bool bindMaterials = true);
+
+    // same as DrawSubMeshes, but draws instanceCount copies with glDrawElementsInstanced. the model matrix of every copy
+    // is read from instanceBuffer (tightly packed mat4s starting at instanceOffset) by the INSTANCED shader variants
+    void DrawSubMeshesInstanced(Shader& shader, size_t first, size_t count, unsigned int instanceBuffer, size_t instanceOffset,
+        unsigned int instanceCount, bool bindMaterials = true);
+
+    // GPU buffers holding the packed vertices and the indices, both never change after the upload
+    unsigned int GetVertexBuffer() const { return VBO; }
+    unsigned int GetIndexBuffer() const { return EBO; }
+
+    // deletes the VAO and both buffers, for meshes whose geometry was copied elsewhere (the indirect arena).
+    // the mesh can't be drawn afterwards
+    void ReleaseGpuBuffers();
+
 private:
     // render data 
     unsigned int VBO, EBO;
 
     // initializes all the buffer objects/arrays
-    void setupMesh();
+    void setupMesh(bool keepCpuData);
+
+    // computes the bounds of every submesh and of the whole mesh from the CPU vertices
+    void computeBounds();
+
+    // names the sampler uniform of every texture of every submesh, so drawing never builds strings
+    void assignSamplerNames();
+
+    // draws the ranges of count submeshes starting at first with the VAO already bound, instanced when instanceCount > 0
+    void drawRanges(Shader& shader, size_t first, size_t count, bool bindMaterials, unsigned int instanceCount);
+
+    // binds the textures of a submesh and points the samplers at them
+    void bindTextures(Shader& shader, const SubMesh& subMesh);
 };
 #endif
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "Model.h"
 
 
-Model::Model(string const& path, bool gamma) : gammaCorrection(gamma)
+Model::Model(string const& path, bool gamma, const ModelOptions& options) : gammaCorrection(gamma), options(options)
 {
     loadModel(path);
 }
@@ -15,6 +15,18 @@ void Model::Draw(Shader& shader)
 unsigned int Model::TextureFromFile(const char* path, const std::string& directory, bool gamma) {
     std::string filename = directory + "/" + path;
 
+    // prefer the block compressed copy written by --compress-textures
+    CompressedImage compressed;
+    if (TextureCompressor::HasCompressed(filename) && TextureCompressor::Load(TextureCompressor::GetCompressedPath(filename), compressed))
+    {
+        unsigned int textureID = TextureCompressor::Upload(compressed, gamma);
+        if (textureID != 0)
+        {
+            std::cout << "Loaded compressed texture: " << path << std::endl;
+            return textureID;
+        }
+    }
+
     int width, height, channels;
     unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, STBI_rgb_alpha);
 
@@ -23,16 +35,7 @@ unsigned int Model::TextureFromFile(const char* path, const std::string& directo
         return 0;
     }
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, gamma ? GL_SRGB_ALPHA : GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
-    // Set texture parameters (if needed)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    unsigned int textureID = TextureLoader::Upload(data, width, height, gamma);
 
     // Free STB image data
     stbi_image_free(data);
@@ -43,26 +46,176 @@ unsigned int Model::TextureFromFile(const char* path, const std::string& directo
 }
 
 void Model::loadModel(string const& path)
+{
+    const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    // try the binary cache first, ASSIMP only runs when it is missing or stale
+    ModelData data;
+    const string cachePath = ModelCache::GetCachePath(path);
+    const uint64_t sourceHash = ModelCache::HashSource(path);
+    if (!ModelCache::Load(cachePath, sourceHash, importFlags, data))
+    {
+        if (!importModel(path, importFlags, data))
+            return;
+        ModelCache::Save(cachePath, sourceHash, importFlags, data);
+    }
+
+    // resolve the textures of every material the meshes actually use, then create the meshes
+    vector<bool> materialUsed(data.materials.size(), false);
+    for (const MeshData& mesh : data.meshes)
+        materialUsed[mesh.materialIndex] = true;
+    vector<vector<Texture>> materialTextures = loadMaterialTextures(data.materials, materialUsed);
+
+    size_t vertexCount = 0;
+    for (const MeshData& mesh : data.meshes)
+        vertexCount += mesh.vertices.size();
+
+    if (options.mergeMeshes)
+        mergeMeshes(data, materialTextures);
+    else
+    {
+        meshes.reserve(data.meshes.size());
+        for (MeshData& mesh : data.meshes)
+            meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), materialTextures[mesh.materialIndex], options.vertexLayout, options.keepCpuData);
+    }
+    buildBoundingVolumes();
+    std::cout << "Vertex buffers: " << vertexCount * options.vertexLayout.GetStride() / 1024 << " KB (" << options.vertexLayout.GetStride()
+        << " bytes per vertex instead of " << sizeof(Vertex) << ")" << std::endl;
+}
+
+unsigned int Model::GetSubMeshCount() const
+{
+    return meshFirstSubMesh.empty() ? 0 : meshFirstSubMesh.back() + static_cast<unsigned int>(meshes.back().subMeshes.size());
+}
+
+unsigned int Model::Cull(const Frustum& frustum, unsigned int passBit, vector<unsigned int>& subMeshPasses) const
+{
+    unsigned int found = 0;
+    bvh.Query(frustum, [&](unsigned int subMesh) {
+        subMeshPasses[subMesh] |= passBit;
+        found++;
+    });
+    return found;
+}
+
+void Model::buildBoundingVolumes()
+{
+    // the Cull list holds the submeshes of every mesh one after the other
+    vector<AABB> subMeshBounds;
+    meshFirstSubMesh.clear();
+    bounds = AABB();
+    for (const Mesh& mesh : meshes)
+    {
+        meshFirstSubMesh.push_back(static_cast<unsigned int>(subMeshBounds.size()));
+        for (const SubMesh& subMesh : mesh.subMeshes)
+            subMeshBounds.push_back(subMesh.bounds);
+        bounds.Expand(mesh.bounds);
+    }
+    bvh.Build(subMeshBounds);
+}
+
+void Model::mergeMeshes(ModelData& data, const vector<vector<Texture>>& materialTextures)
+{
+    // materials that bind exactly the same textures can be drawn together, give them the same batch id
+    vector<unsigned int> batchOf(materialTextures.size());
+    for (unsigned int i = 0; i < materialTextures.size(); i++)
+    {
+        batchOf[i] = i;
+        for (unsigned int j = 0; j < i; j++)
+        {
+            bool same = materialTextures[i].size() == materialTextures[j].size();
+            for (size_t t = 0; same && t < materialTextures[i].size(); t++)
+                same = materialTextures[i][t].id == materialTextures[j][t].id;
+            if (same)
+            {
+                batchOf[i] = batchOf[j];
+                break;
+            }
+        }
+    }
+
+    // order the meshes by their first texture then by batch, so texture rebinds between batches are rare too
+    vector<size_t> order(data.meshes.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    auto firstTexture = [&](const MeshData& mesh) {
+        const vector<Texture>& textures = materialTextures[mesh.materialIndex];
+        return textures.empty() ? 0u : textures[0].id;
+    };
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const MeshData& meshA = data.meshes[a];
+        const MeshData& meshB = data.meshes[b];
+        if (firstTexture(meshA) != firstTexture(meshB))
+            return firstTexture(meshA) < firstTexture(meshB);
+        return batchOf[meshA.materialIndex] < batchOf[meshB.materialIndex];
+    });
+
+    // append every mesh to one shared vertex/index buffer, each one keeps its own range
+    size_t vertexCount = 0, indexCount = 0;
+    for (const MeshData& mesh : data.meshes)
+    {
+        vertexCount += mesh.vertices.size();
+        indexCount += mesh.indices.size();
+    }
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<SubMesh> subMeshes;
+    vertices.reserve(vertexCount);
+    indices.reserve(indexCount);
+    subMeshes.reserve(data.meshes.size());
+    unsigned int batchCount = 0;
+    for (size_t i : order)
+    {
+        MeshData& mesh = data.meshes[i];
+        SubMesh subMesh;
+        subMesh.firstIndex = static_cast<unsigned int>(indices.size());
+        subMesh.indexCount = static_cast<unsigned int>(mesh.indices.size());
+        subMesh.materialIndex = batchOf[mesh.materialIndex];
+        subMesh.textures = materialTextures[mesh.materialIndex];
+        if (subMeshes.empty() || subMeshes.back().materialIndex != subMesh.materialIndex)
+            batchCount++;
+        subMeshes.push_back(std::move(subMesh));
+
+        // indices are rebased onto the merged vertex buffer
+        const unsigned int baseVertex = static_cast<unsigned int>(vertices.size());
+        for (unsigned int index : mesh.indices)
+            indices.push_back(baseVertex + index);
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        vector<Vertex>().swap(mesh.vertices);
+        vector<unsigned int>().swap(mesh.indices);
+    }
+
+    std::cout << "Merged " << data.meshes.size() << " meshes into " << batchCount << " material batches" << std::endl;
+    meshes.emplace_back(std::move(vertices), std::move(indices), std::move(subMeshes), options.vertexLayout, options.keepCpuData);
+}
+
+bool Model::importModel(string const& path, unsigned int importFlags, ModelData& data)
 {
     std::cout << "Loading model: " << path << std::endl;
     // read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    const aiScene* scene = importer.ReadFile(path, importFlags);
     std::cout << "Scene loaded" << std::endl;
     // check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
         cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-        return;
+        return false;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
+
+    // keep the full material table, meshes refer to it by index
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+        data.materials.push_back(processMaterial(scene->mMaterials[i]));
 
     // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    processNode(scene->mRootNode, scene, data);
+    return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, const aiScene* scene, ModelData& data)
 {
     std::cout << "Processing node: " << node->mName.C_Str() << std::endl;
     // process each mesh located at the current node
@@ -71,22 +224,24 @@ void Model::processNode(aiNode* node, const aiScene* scene)
         // the node object only contains indices to index the actual objects in the scene. 
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        data.meshes.push_back(processMesh(mesh));
     }
     // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, data);
     }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+MeshData Model::processMesh(aiMesh* mesh)
 {
     std::cout << "Processing mesh: " << mesh->mName.C_Str() << std::endl;
     // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
+    MeshData data;
+    vector<Vertex>& vertices = data.vertices;
+    vector<unsigned int>& indices = data.indices;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -139,8 +294,15 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    // materials are resolved by index once all meshes are known
+    data.materialIndex = mesh->mMaterialIndex;
+    return data;
+}
+
+MaterialData Model::processMaterial(aiMaterial* material)
+{
+    std::cout << "Loading material textures: " << material->GetName().C_Str() << std::endl;
+    MaterialData data;
     // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
     // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
     // Same applies to other texture as the following list summarizes:
@@ -149,50 +311,94 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
     // normal: texture_normalN
 
     // 1. diffuse maps
-    vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data);
     // 2. specular maps
-    vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data);
     // 3. normal maps
-    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data);
     // 4. height maps
-    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data);
+    return data;
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+void Model::collectMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, MaterialData& material)
 {
-    std::cout << "Loading material textures: " << mat->GetName().C_Str() << std::endl;
-    vector<Texture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        material.textures.push_back({ typeName, str.C_Str() });
+    }
+}
+
+vector<vector<Texture>> Model::loadMaterialTextures(const vector<MaterialData>& materials, const vector<bool>& used)
+{
+    // textures are shared by every model through the registry, keyed by their canonical path
+    TextureRegistry& registry = TextureRegistry::Instance();
+    unordered_map<string, TextureHandle> handles;
+    unordered_map<string, string> canonicalPaths; // material path -> canonical path
+
+    // queue every texture that hasn't been loaded yet, so all of them are decoded in parallel
+    TextureLoader loader;
+    vector<string> pending;
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        if (!used[i])
+            continue;
+        for (const TextureRef& ref : materials[i].textures)
         {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+            auto canonical = canonicalPaths.find(ref.path);
+            if (canonical == canonicalPaths.end())
+                canonical = canonicalPaths.emplace(ref.path, TextureRegistry::Canonicalize(this->directory + "/" + ref.path)).first;
+            const string& canonicalPath = canonical->second;
+            // check if texture was loaded (or queued) before and if so, continue to next one: skip loading a new texture
+            if (handles.count(canonicalPath))
+                continue;
+            TextureHandle handle = registry.Find(canonicalPath);
+            if (!handle && options.textureStreamer)
+                handle = registry.Insert(canonicalPath, options.textureStreamer->Request(canonicalPath, false));
+            else if (!handle)
             {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
+                loader.Add(canonicalPath, false);
+                pending.push_back(canonicalPath);
             }
+            handles.emplace(canonicalPath, std::move(handle));
         }
-        if (!skip)
-        {   // if texture hasn't been loaded already, load it
+    }
+
+    vector<unsigned int> ids = loader.LoadAll();
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        if (ids[i] != 0)
+            handles[pending[i]] = registry.Insert(pending[i], ids[i]);
+    }
+
+    vector<vector<Texture>> textures(materials.size());
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        if (!used[i])
+            continue;
+        for (const TextureRef& ref : materials[i].textures)
+        {
             Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory, false);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+            texture.handle = handles[canonicalPaths[ref.path]];
+            texture.id = texture.handle.GetID();
+            texture.type = ref.type;
+            texture.path = ref.path;
+            textures[i].push_back(texture);
         }
     }
+
+    // remember every texture this model uses, the handles keep them loaded for the model's lifetime
+    for (auto& entry : handles)
+    {
+        if (!entry.second)
+            continue;
+        Texture texture;
+        texture.id = entry.second.GetID();
+        texture.path = entry.first;
+        texture.handle = entry.second;
+        textures_loaded.push_back(texture);
+    }
     return textures;
-}
\ No newline at end of file
+}
@@ -8,48 +8,98 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "BoundingVolumeHierarchy.h"
+#include "Bounds.h"
 #include "Mesh.h"
+#include "ModelCache.h"
 #include "Shader.h"
+#include "TextureCompressor.h"
+#include "TextureLoader.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
 
+#include <algorithm>
 #include <string>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 //unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
+// load-time options of a Model
+struct ModelOptions {
+    // how the meshes store their vertices on the GPU, by default only the attributes our shaders read
+    VertexLayout vertexLayout = VertexLayout::Compact();
+    // keep vertices/indices of every mesh in memory after the upload (for picking/collision code)
+    bool keepCpuData = false;
+    // static geometry only: merge all meshes into one vertex/index buffer, sorted by material, so a draw
+    // binds one VAO and issues one call per material instead of one per mesh
+    bool mergeMeshes = false;
+    // when set, textures not loaded yet start as placeholders and stream in through it, the model is usable right away
+    TextureStreamer* textureStreamer = nullptr;
+};
+
 class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the textures this model uses, their handles keep them alive in the process-wide TextureRegistry.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    ModelOptions options;
+    AABB bounds; // model space bounds of every mesh
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false);
+    Model(string const& path, bool gamma = false, const ModelOptions& options = ModelOptions());
 
     // draws the model, and thus all its meshes
     void Draw(Shader& shader);
 
+    // number of submeshes over all meshes, the size of the list Cull fills
+    unsigned int GetSubMeshCount() const;
+
+    // position of a submesh in the list Cull fills
+    unsigned int GetSubMeshIndex(size_t mesh, size_t subMesh) const { return meshFirstSubMesh[mesh] + static_cast<unsigned int>(subMesh); }
+
+    // walks the BVH and ORs passBit into subMeshPasses[i] for every submesh intersecting the frustum.
+    // the frustum must be in model space (built from viewProjection * model). returns the number of submeshes found.
+    unsigned int Cull(const Frustum& frustum, unsigned int passBit, vector<unsigned int>& subMeshPasses) const;
+
 
     unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
 
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    BoundingVolumeHierarchy bvh;          // over every submesh, item i is the submesh at position i of the Cull list
+    vector<unsigned int> meshFirstSubMesh; // position of the first submesh of each mesh in the Cull list
+
+    // loads a model from its binary cache, or with ASSIMP when the cache is missing or stale, and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path);
 
+    // builds the BVH over the bounds of every submesh
+    void buildBoundingVolumes();
+
+    // builds a single mesh holding every mesh of data as material-sorted ranges of shared buffers.
+    void mergeMeshes(ModelData& data, const vector<vector<Texture>>& materialTextures);
+
+    // imports the model with ASSIMP into data, returns false on import errors.
+    bool importModel(string const& path, unsigned int importFlags, ModelData& data);
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene);
+    void processNode(aiNode* node, const aiScene* scene, ModelData& data);
+
+    MeshData processMesh(aiMesh* mesh);
 
+    // collects the texture references of a material, in the order the shaders expect them.
+    MaterialData processMaterial(aiMaterial* material);
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    // appends the textures of a given type referenced by mat to material.
+    void collectMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, MaterialData& material);
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+    // checks all textures of the used materials and loads the textures that aren't loaded yet, decoding them in parallel.
+    // the required info is returned as one list of Texture structs per material.
+    vector<vector<Texture>> loadMaterialTextures(const vector<MaterialData>& materials, const vector<bool>& used);
 
 };
 
@@ -0,0 +1,354 @@
+#include "ModelCache.h"
+
+#include "Utils.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char CACHE_MAGIC[4] = { 'T', 'S', 'M', 'C' };
+    const uint64_t BLOB_ALIGNMENT = 16;
+
+    // on-disk layout, every offset is relative to the start of the file
+    struct CacheHeader {
+        char     magic[4];
+        uint32_t version;
+        uint32_t importFlags;
+        uint32_t vertexSize;
+        uint64_t sourceHash;
+        uint64_t fileSize;
+        uint32_t meshCount;
+        uint32_t materialCount;
+        uint32_t textureCount;
+        uint32_t stringTableSize;
+        uint64_t meshTableOffset;
+        uint64_t materialTableOffset;
+        uint64_t textureTableOffset;
+        uint64_t stringTableOffset;
+    };
+
+    struct CacheMeshRecord {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t materialIndex;
+        uint32_t padding;
+    };
+
+    struct CacheMaterialRecord {
+        uint32_t firstTexture;
+        uint32_t textureCount;
+    };
+
+    struct CacheTextureRecord {
+        uint32_t typeOffset;
+        uint32_t typeLength;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    // read-only memory mapping of a whole file
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path)
+        {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return;
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+                return;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping)
+                return;
+            data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (data)
+                size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+            fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size == 0)
+                return;
+            void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view == MAP_FAILED)
+                return;
+            data = static_cast<const unsigned char*>(view);
+            size = static_cast<uint64_t>(info.st_size);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (data)
+                UnmapViewOfFile(data);
+            if (mapping)
+                CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (data)
+                munmap(const_cast<unsigned char*>(data), size);
+            if (fd >= 0)
+                close(fd);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const unsigned char* data = nullptr;
+        uint64_t size = 0;
+
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+
+    // true if [offset, offset + length) lies inside the mapped file
+    bool InRange(const MappedFile& file, uint64_t offset, uint64_t length)
+    {
+        return offset <= file.size && length <= file.size - offset;
+    }
+}
+
+std::string ModelCache::GetCachePath(const std::string& modelPath)
+{
+    return modelPath + ".meshcache";
+}
+
+uint64_t ModelCache::HashFile(const std::string& path)
+{
+    MappedFile file(path);
+    if (!file.data)
+        return 0;
+    return Fnv1a(file.data, file.size);
+}
+
+uint64_t ModelCache::HashSource(const std::string& modelPath)
+{
+    MappedFile file(modelPath);
+    if (!file.data)
+        return 0;
+    uint64_t hash = Fnv1a(file.data, file.size);
+
+    // material libraries are relative to the model directory, a missing one still changes the hash
+    const std::string directory = modelPath.substr(0, modelPath.find_last_of('/'));
+    const char* text = reinterpret_cast<const char*>(file.data);
+    const char* end = text + file.size;
+    for (const char* line = text; line < end;)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!lineEnd)
+            lineEnd = end;
+        while (line < lineEnd && (*line == ' ' || *line == '\t'))
+            line++;
+        if (lineEnd - line > 7 && std::memcmp(line, "mtllib", 6) == 0 && (line[6] == ' ' || line[6] == '\t'))
+        {
+            const char* name = line + 7;
+            const char* nameEnd = lineEnd;
+            while (name < nameEnd && (*name == ' ' || *name == '\t'))
+                name++;
+            while (nameEnd > name && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t' || nameEnd[-1] == '\r'))
+                nameEnd--;
+            const uint64_t libraryHash = HashFile(directory + "/" + std::string(name, nameEnd));
+            hash = Fnv1a(&libraryHash, sizeof(libraryHash), hash);
+        }
+        line = lineEnd + 1;
+    }
+    return hash;
+}
+
+bool ModelCache::Load(const std::string& cachePath, uint64_t sourceHash, unsigned int importFlags, ModelData& data)
+{
+    MappedFile file(cachePath);
+    if (!file.data || file.size < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file.data, sizeof(CacheHeader));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != VERSION ||
+        header.vertexSize != sizeof(Vertex) ||
+        header.importFlags != importFlags ||
+        header.sourceHash != sourceHash ||
+        header.fileSize != file.size)
+    {
+        std::cout << "Model cache is stale: " << cachePath << std::endl;
+        return false;
+    }
+
+    if (!InRange(file, header.meshTableOffset, uint64_t(header.meshCount) * sizeof(CacheMeshRecord)) ||
+        !InRange(file, header.materialTableOffset, uint64_t(header.materialCount) * sizeof(CacheMaterialRecord)) ||
+        !InRange(file, header.textureTableOffset, uint64_t(header.textureCount) * sizeof(CacheTextureRecord)) ||
+        !InRange(file, header.stringTableOffset, header.stringTableSize))
+    {
+        std::cout << "ERROR::MODEL_CACHE:: corrupt tables in " << cachePath << std::endl;
+        return false;
+    }
+
+    const auto* meshRecords = reinterpret_cast<const CacheMeshRecord*>(file.data + header.meshTableOffset);
+    const auto* materialRecords = reinterpret_cast<const CacheMaterialRecord*>(file.data + header.materialTableOffset);
+    const auto* textureRecords = reinterpret_cast<const CacheTextureRecord*>(file.data + header.textureTableOffset);
+    const char* strings = reinterpret_cast<const char*>(file.data + header.stringTableOffset);
+
+    ModelData result;
+    result.materials.resize(header.materialCount);
+    for (uint32_t i = 0; i < header.materialCount; i++)
+    {
+        const CacheMaterialRecord& record = materialRecords[i];
+        if (uint64_t(record.firstTexture) + record.textureCount > header.textureCount)
+            return false;
+        for (uint32_t j = 0; j < record.textureCount; j++)
+        {
+            const CacheTextureRecord& texture = textureRecords[record.firstTexture + j];
+            if (uint64_t(texture.typeOffset) + texture.typeLength > header.stringTableSize ||
+                uint64_t(texture.pathOffset) + texture.pathLength > header.stringTableSize)
+                return false;
+            result.materials[i].textures.push_back({
+                std::string(strings + texture.typeOffset, texture.typeLength),
+                std::string(strings + texture.pathOffset, texture.pathLength) });
+        }
+    }
+
+    result.meshes.resize(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++)
+    {
+        const CacheMeshRecord& record = meshRecords[i];
+        if (!InRange(file, record.vertexOffset, uint64_t(record.vertexCount) * sizeof(Vertex)) ||
+            !InRange(file, record.indexOffset, uint64_t(record.indexCount) * sizeof(unsigned int)) ||
+            record.materialIndex >= header.materialCount)
+        {
+            std::cout << "ERROR::MODEL_CACHE:: corrupt mesh record in " << cachePath << std::endl;
+            return false;
+        }
+        // blobs are stored exactly as they are laid out in memory, so this is a straight copy out of the mapping
+        const auto* vertices = reinterpret_cast<const Vertex*>(file.data + record.vertexOffset);
+        const auto* indices = reinterpret_cast<const unsigned int*>(file.data + record.indexOffset);
+        MeshData& mesh = result.meshes[i];
+        mesh.vertices.assign(vertices, vertices + record.vertexCount);
+        mesh.indices.assign(indices, indices + record.indexCount);
+        mesh.materialIndex = record.materialIndex;
+    }
+
+    data = std::move(result);
+    std::cout << "Loaded model cache: " << cachePath << std::endl;
+    return true;
+}
+
+bool ModelCache::Save(const std::string& cachePath, uint64_t sourceHash, unsigned int importFlags, const ModelData& data)
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = VERSION;
+    header.importFlags = importFlags;
+    header.vertexSize = sizeof(Vertex);
+    header.sourceHash = sourceHash;
+    header.meshCount = static_cast<uint32_t>(data.meshes.size());
+    header.materialCount = static_cast<uint32_t>(data.materials.size());
+
+    // build the material/texture tables and the string table
+    std::vector<CacheMaterialRecord> materialRecords;
+    std::vector<CacheTextureRecord> textureRecords;
+    std::string strings;
+    for (const MaterialData& material : data.materials)
+    {
+        materialRecords.push_back({ static_cast<uint32_t>(textureRecords.size()), static_cast<uint32_t>(material.textures.size()) });
+        for (const TextureRef& texture : material.textures)
+        {
+            CacheTextureRecord record;
+            record.typeOffset = static_cast<uint32_t>(strings.size());
+            record.typeLength = static_cast<uint32_t>(texture.type.size());
+            strings += texture.type;
+            record.pathOffset = static_cast<uint32_t>(strings.size());
+            record.pathLength = static_cast<uint32_t>(texture.path.size());
+            strings += texture.path;
+            textureRecords.push_back(record);
+        }
+    }
+    header.textureCount = static_cast<uint32_t>(textureRecords.size());
+    header.stringTableSize = static_cast<uint32_t>(strings.size());
+
+    // lay out the file: header, tables, then every blob on a 16 byte boundary
+    uint64_t offset = AlignUp<uint64_t>(sizeof(CacheHeader), BLOB_ALIGNMENT);
+    header.meshTableOffset = offset;
+    offset = AlignUp<uint64_t>(offset + data.meshes.size() * sizeof(CacheMeshRecord), BLOB_ALIGNMENT);
+    header.materialTableOffset = offset;
+    offset = AlignUp<uint64_t>(offset + materialRecords.size() * sizeof(CacheMaterialRecord), BLOB_ALIGNMENT);
+    header.textureTableOffset = offset;
+    offset = AlignUp<uint64_t>(offset + textureRecords.size() * sizeof(CacheTextureRecord), BLOB_ALIGNMENT);
+
+    std::vector<CacheMeshRecord> meshRecords;
+    for (const MeshData& mesh : data.meshes)
+    {
+        CacheMeshRecord record = {};
+        record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        record.materialIndex = mesh.materialIndex;
+        record.vertexOffset = offset;
+        offset = AlignUp<uint64_t>(offset + mesh.vertices.size() * sizeof(Vertex), BLOB_ALIGNMENT);
+        record.indexOffset = offset;
+        offset = AlignUp<uint64_t>(offset + mesh.indices.size() * sizeof(unsigned int), BLOB_ALIGNMENT);
+        meshRecords.push_back(record);
+    }
+    header.stringTableOffset = offset;
+    header.fileSize = offset + strings.size();
+
+    std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::MODEL_CACHE:: can't write " << cachePath << std::endl;
+        return false;
+    }
+
+    auto writeAt = [&out](uint64_t position, const void* bytes, uint64_t size) {
+        // zero-fill the alignment padding up to the requested position
+        static const char zeros[BLOB_ALIGNMENT] = {};
+        uint64_t current = static_cast<uint64_t>(out.tellp());
+        if (position > current)
+            out.write(zeros, position - current);
+        if (size > 0)
+            out.write(static_cast<const char*>(bytes), size);
+    };
+
+    writeAt(0, &header, sizeof(CacheHeader));
+    writeAt(header.meshTableOffset, meshRecords.data(), meshRecords.size() * sizeof(CacheMeshRecord));
+    writeAt(header.materialTableOffset, materialRecords.data(), materialRecords.size() * sizeof(CacheMaterialRecord));
+    writeAt(header.textureTableOffset, textureRecords.data(), textureRecords.size() * sizeof(CacheTextureRecord));
+    for (size_t i = 0; i < data.meshes.size(); i++)
+    {
+        writeAt(meshRecords[i].vertexOffset, data.meshes[i].vertices.data(), data.meshes[i].vertices.size() * sizeof(Vertex));
+        writeAt(meshRecords[i].indexOffset, data.meshes[i].indices.data(), data.meshes[i].indices.size() * sizeof(unsigned int));
+    }
+    writeAt(header.stringTableOffset, strings.data(), strings.size());
+
+    if (!out)
+    {
+        std::cout << "ERROR::MODEL_CACHE:: failed while writing " << cachePath << std::endl;
+        return false;
+    }
+    std::cout << "Saved model cache: " << cachePath << std::endl;
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include "Vertex.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a texture referenced by a material: its sampler type (texture_diffuse, ...) and its path relative to the model directory
+struct TextureRef {
+    std::string type;
+    std::string path;
+};
+
+// all the textures referenced by one material of the source model
+struct MaterialData {
+    std::vector<TextureRef> textures;
+};
+
+// the geometry of one mesh, exactly as it is uploaded to the GPU
+struct MeshData {
+    std::vector<Vertex>       vertices;
+    std::vector<unsigned int> indices;
+    unsigned int              materialIndex = 0;
+};
+
+// everything Model needs to build its meshes, independent of ASSIMP
+struct ModelData {
+    std::vector<MeshData>     meshes;
+    std::vector<MaterialData> materials;
+};
+
+// Binary cache of imported models, stored next to the source file as "<model>.meshcache".
+// The file is a flat, 16-byte aligned image (header, tables, vertex/index blobs, string table) that is
+// memory mapped on load, so a warm start only copies blobs instead of running ASSIMP again.
+// A cache is considered stale when the format version, the Vertex layout, the import flags or the
+// hash of the source files (the model and the material libraries it references) differ from the ones it was written with.
+class ModelCache
+{
+public:
+    // bump whenever the on-disk layout changes
+    static const uint32_t VERSION = 1;
+
+    // returns the cache file path used for the given model path
+    static std::string GetCachePath(const std::string& modelPath);
+
+    // 64-bit FNV-1a hash of the file contents, 0 if the file can't be read
+    static uint64_t HashFile(const std::string& path);
+
+    // hash of the model file combined with the hash of every .mtl file named by its "mtllib" lines,
+    // the cache stores the resolved materials so editing a material library must invalidate it too
+    static uint64_t HashSource(const std::string& modelPath);
+
+    // fills data from the cache file, returns false if the cache is missing, corrupt or stale
+    static bool Load(const std::string& cachePath, uint64_t sourceHash, unsigned int importFlags, ModelData& data);
+
+    // writes data to the cache file, returns false on I/O errors
+    static bool Save(const std::string& cachePath, uint64_t sourceHash, unsigned int importFlags, const ModelData& data);
+};
+
+#endif
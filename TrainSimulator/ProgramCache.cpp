@@ -0,0 +1,123 @@
+#include "ProgramCache.h"
+
+#include "GLExtensions.h"
+#include "Utils.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	const char CACHE_MAGIC[4] = { 'T', 'S', 'P', 'B' };
+	const char CACHE_DIRECTORY[] = "shadercache";
+
+	struct CacheHeader {
+		char     magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binaryLength;
+	};
+
+	// hashes the string and its terminator, so "ab" + "c" and "a" + "bc" differ
+	uint64_t HashString(const char* text, uint64_t hash)
+	{
+		return text ? Fnv1a(text, std::strlen(text) + 1, hash) : Fnv1a("", 1, hash);
+	}
+}
+
+std::string ProgramCache::GetCachePath(const std::string& name)
+{
+	std::ostringstream path;
+	path << CACHE_DIRECTORY << "/" << std::hex << Fnv1a(name.data(), name.size()) << ".programcache";
+	return path.str();
+}
+
+uint64_t ProgramCache::MakeKey(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	uint64_t key = HashString(vertexSource.c_str(), 14695981039346656037ull);
+	key = HashString(fragmentSource.c_str(), key);
+	key = HashString(reinterpret_cast<const char*>(glGetString(GL_VENDOR)), key);
+	key = HashString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)), key);
+	return HashString(reinterpret_cast<const char*>(glGetString(GL_VERSION)), key);
+}
+
+bool ProgramCache::Load(const std::string& cachePath, uint64_t key, unsigned int program)
+{
+	const GLExtensions& extensions = GLExtensions::Instance();
+	if (!extensions.programBinary)
+		return false;
+
+	std::ifstream file(cachePath, std::ios::binary);
+	CacheHeader header = {};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file)
+		return false;
+	if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != VERSION || header.key != key)
+	{
+		std::cout << "Program cache is stale: " << cachePath << std::endl;
+		return false;
+	}
+
+	std::vector<char> binary(header.binaryLength);
+	file.read(binary.data(), binary.size());
+	if (!file)
+	{
+		std::cout << "ERROR::PROGRAM_CACHE:: truncated binary in " << cachePath << std::endl;
+		return false;
+	}
+
+	// drivers may refuse binaries from an older build of themselves even when the version string is the same
+	extensions.ProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+		std::cout << "WARNING::PROGRAM_CACHE:: binary rejected by the driver: " << cachePath << std::endl;
+	return linked == GL_TRUE;
+}
+
+bool ProgramCache::Save(const std::string& cachePath, uint64_t key, unsigned int program)
+{
+	const GLExtensions& extensions = GLExtensions::Instance();
+	if (!extensions.programBinary)
+		return false;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return false;
+	std::vector<char> binary(length);
+	GLenum binaryFormat = 0;
+	GLsizei written = 0;
+	extensions.GetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+	if (written <= 0)
+		return false;
+
+	std::error_code error;
+	fs::create_directories(CACHE_DIRECTORY, error);
+
+	CacheHeader header = {};
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = VERSION;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = static_cast<uint32_t>(written);
+
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(binary.data(), written);
+	if (!file)
+	{
+		std::cout << "ERROR::PROGRAM_CACHE:: can't write " << cachePath << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+// Binary cache of linked programs (needs GLExtensions::programBinary), one file per program in "shadercache/".
+// A file holds what glGetProgramBinary returned together with a key: the hash of the final stage sources (defines
+// included) and of the driver vendor, renderer and version strings, so editing a shader or updating the driver
+// makes the binary stale. The driver may still reject a binary it wrote, callers compile from source then.
+class ProgramCache
+{
+public:
+	// bump whenever the on-disk layout changes
+	static const uint32_t VERSION = 1;
+
+	// returns the cache file path of the program called name (its stages and defines)
+	static std::string GetCachePath(const std::string& name);
+
+	// hash of the sources of every stage and of the current driver
+	static uint64_t MakeKey(const std::string& vertexSource, const std::string& fragmentSource);
+
+	// loads the binary into program, returns false if the file is missing or stale or the driver rejects it
+	static bool Load(const std::string& cachePath, uint64_t key, unsigned int program);
+
+	// writes the binary of a linked program, which must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	static bool Save(const std::string& cachePath, uint64_t key, unsigned int program);
+};
+
+#endif
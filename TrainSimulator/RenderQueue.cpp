@@ -0,0 +1,143 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// two ranges share a material when they bind the same textures, not only the same first one
+	bool SameTextures(const SubMesh& a, const SubMesh& b)
+	{
+		if (a.textures.size() != b.textures.size())
+			return false;
+		for (size_t i = 0; i < a.textures.size(); i++)
+			if (a.textures[i].id != b.textures[i].id)
+				return false;
+		return true;
+	}
+}
+
+AABB SceneObject::GetWorldBounds() const
+{
+	AABB bounds;
+	if (!model)
+		return bounds;
+	if (!instanced)
+		return model->bounds.Transform(transform);
+	for (const glm::mat4& instance : instances)
+		bounds.Expand(model->bounds.Transform(instance));
+	return bounds;
+}
+
+void CullingStats::Reset(size_t viewCount)
+{
+	subMeshCount = 0;
+	visible.assign(viewCount, 0);
+	culled.assign(viewCount, 0);
+	occluded = 0;
+}
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+void RenderQueue::AddModel(Model& model, size_t objectOffset, const std::vector<unsigned int>& subMeshPasses, unsigned int variant, EDrawFilter drawClass, float depth,
+	size_t instanceOffset, unsigned int instanceCount)
+{
+	for (size_t meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++)
+	{
+		Mesh& mesh = model.meshes[meshIndex];
+		const unsigned int* passes = subMeshPasses.data() + model.GetSubMeshIndex(meshIndex, 0);
+
+		// one packet per run of submeshes with the same material and passes, the mesh draws such a run with as few calls as it can
+		const unsigned int subMeshCount = static_cast<unsigned int>(mesh.subMeshes.size());
+		for (unsigned int i = 0; i < subMeshCount;)
+		{
+			unsigned int next = i + 1;
+			while (next < subMeshCount && mesh.subMeshes[next].materialIndex == mesh.subMeshes[i].materialIndex && passes[next] == passes[i])
+				next++;
+			const unsigned int passMask = passes[i];
+			if (passMask == 0)
+			{
+				i = next;
+				continue;
+			}
+
+			const SubMesh& subMesh = mesh.subMeshes[i];
+			DrawPacket packet;
+			packet.mesh = &mesh;
+			packet.firstSubMesh = i;
+			packet.subMeshCount = next - i;
+			packet.material = subMesh.textures.empty() ? 0 : subMesh.textures[0].id;
+			packet.objectOffset = objectOffset;
+			packet.passMask = passMask;
+			packet.variant = variant;
+			packet.drawClass = drawClass;
+			packet.depth = depth;
+			packet.instanceOffset = instanceOffset;
+			packet.instanceCount = instanceCount;
+			packet.sortKey = MakeSortKey(packet);
+			packets.push_back(packet);
+			i = next;
+		}
+	}
+}
+
+void RenderQueue::Sort()
+{
+	std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) {
+		return a.sortKey < b.sortKey;
+	});
+}
+
+void RenderQueue::Submit(ERenderPass pass, Shader* const (&shaders)[SHADER_VARIANT_COUNT], const UniformRing& uniforms, bool bindMaterials, EDrawFilter filter) const
+{
+	const Shader* boundShader = nullptr;
+	size_t boundObject = SIZE_MAX;
+	const SubMesh* boundMaterial = nullptr;
+
+	for (const DrawPacket& packet : packets)
+	{
+		if ((packet.passMask & pass) == 0 || (filter & packet.drawClass) == 0 || packet.drawClass == DRAW_INDIRECT)
+			continue;
+
+		Shader* shader = shaders[packet.variant];
+		if (shader != boundShader)
+		{
+			shader->Use();
+			boundShader = shader;
+			// sampler uniforms belong to the program, so a new program needs its textures set up again
+			boundMaterial = nullptr;
+		}
+		if (packet.objectOffset != boundObject)
+		{
+			uniforms.Bind(PER_OBJECT_BINDING, packet.objectOffset, sizeof(PerObjectBlock));
+			boundObject = packet.objectOffset;
+		}
+		const SubMesh& material = packet.mesh->subMeshes[packet.firstSubMesh];
+		const bool bindTextures = bindMaterials && (!boundMaterial || !SameTextures(*boundMaterial, material));
+		if (packet.instanceCount > 0)
+			packet.mesh->DrawSubMeshesInstanced(*shader, packet.firstSubMesh, packet.subMeshCount, uniforms.GetBuffer(), packet.instanceOffset,
+				packet.instanceCount, bindTextures);
+		else
+			packet.mesh->DrawSubMeshes(*shader, packet.firstSubMesh, packet.subMeshCount, bindTextures);
+		boundMaterial = &material;
+	}
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+uint64_t RenderQueue::MakeSortKey(const DrawPacket& packet)
+{
+	// | pass mask (5) | variant (3) | material (24) | depth (32) |
+	// a non-negative float keeps its order when its bits are compared as an unsigned integer
+	uint32_t depthBits = 0;
+	const float depth = std::max(packet.depth, 0.0f);
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	return (static_cast<uint64_t>(packet.passMask & 0x1F) << 59) |
+		(static_cast<uint64_t>(packet.variant & 0x7) << 56) |
+		(static_cast<uint64_t>(packet.material & 0xFFFFFF) << 32) |
+		depthBits;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glm.hpp>
+
+#include "Bounds.h"
+#include "Model.h"
+#include "Shader.h"
+#include "UniformBlocks.h"
+
+#include <cstdint>
+#include <vector>
+
+// passes a draw packet can take part in, one bit each. every shadow cascade is its own pass
+enum ERenderPass : unsigned int {
+	RENDER_PASS_SHADOW_CASCADE0 = 1 << 0, // cascade i is RENDER_PASS_SHADOW_CASCADE0 << i
+	RENDER_PASS_SHADOW          = (1 << MAX_SHADOW_CASCADES) - 1,
+	RENDER_PASS_MAIN            = 1 << MAX_SHADOW_CASCADES,
+	RENDER_PASS_ALL             = RENDER_PASS_SHADOW | RENDER_PASS_MAIN
+};
+
+// the pass of a shadow cascade
+inline ERenderPass GetCascadePass(unsigned int cascade)
+{
+	return static_cast<ERenderPass>(RENDER_PASS_SHADOW_CASCADE0 << cascade);
+}
+
+// which packets a submit draws, by whether their object moves. static objects in the indirect arena are their own class,
+// RenderQueue::Submit never draws them (IndirectRenderer does)
+enum EDrawFilter : unsigned int {
+	DRAW_STATIC     = 1 << 0,
+	DRAW_DYNAMIC    = 1 << 1,
+	DRAW_INDIRECT   = 1 << 2,
+	DRAW_ALL_STATIC = DRAW_STATIC | DRAW_INDIRECT,
+	DRAW_ALL        = DRAW_STATIC | DRAW_DYNAMIC | DRAW_INDIRECT
+};
+
+// program variants a packet can ask for, each pass maps them to its own programs
+enum EShaderVariant : unsigned int {
+	SHADER_VARIANT_DEFAULT,
+	SHADER_VARIANT_UNIFORM_SCALE,
+	SHADER_VARIANT_INSTANCED, // model matrix per instance from a vertex attribute, instances must be uniformly scaled
+	SHADER_VARIANT_INDIRECT,  // INSTANCED reading its texture from an array layer, only used by IndirectRenderer
+	SHADER_VARIANT_COUNT
+};
+
+// something placed in the world: a model, where it is and which passes draw it.
+// an instanced object places a copy of the model at every instance transform and draws them all with one call per mesh
+struct SceneObject {
+	Model*       model = nullptr;
+	glm::mat4    transform = glm::mat4(1.0f);
+	unsigned int passMask = RENDER_PASS_ALL;
+	bool         dynamic = false;   // moves or animates, cached shadow maps only hold static objects
+	bool         instanced = false; // drawn at instances instead of transform
+	bool         indirect = false;  // static object whose meshes live in the indirect arena, set by IndirectRenderer
+	std::vector<glm::mat4> instances; // world transform of every copy of an instanced object
+
+	// world space bounds of the object, or of all its instances
+	AABB GetWorldBounds() const;
+
+	// the EDrawFilter class its packets belong to
+	EDrawFilter GetDrawClass() const { return dynamic ? DRAW_DYNAMIC : (indirect ? DRAW_INDIRECT : DRAW_STATIC); }
+};
+
+// a pass and the view-projection it renders with, packets are culled against it separately
+struct PassView {
+	ERenderPass pass;
+	glm::mat4   viewProjection;
+};
+
+// culling results of one frame, for profiling
+struct CullingStats {
+	unsigned int subMeshCount = 0;       // submeshes of every object taking part in at least one pass
+	std::vector<unsigned int> visible;   // per pass view, submeshes intersecting its frustum
+	std::vector<unsigned int> culled;    // per pass view, submeshes outside its frustum
+	unsigned int occluded = 0;           // submeshes of the main pass inside the camera frustum but hidden in the Hi-Z buffer
+
+	void Reset(size_t viewCount);
+};
+
+// the smallest unit the queue sorts and submits: a range of submeshes of one mesh sharing a material
+struct DrawPacket {
+	Mesh*        mesh;
+	unsigned int firstSubMesh;
+	unsigned int subMeshCount;
+	unsigned int material;     // id of the first texture of the range, 0 without textures
+	size_t       objectOffset; // PerObject block of the owner in the uniform ring
+	unsigned int passMask;
+	unsigned int variant;
+	EDrawFilter  drawClass;    // exactly one bit
+	float        depth;        // view distance, opaque packets are drawn front to back
+	size_t       instanceOffset; // instance matrices in the uniform ring, for instanced packets
+	unsigned int instanceCount;  // 0 for a regular draw
+	uint64_t     sortKey;
+};
+
+// Draw packets collected once per frame, sorted once and submitted by every pass that needs them.
+// Filling the queue issues no GL calls; Submit is the only place that talks to the driver.
+class RenderQueue
+{
+public:
+	void Clear();
+
+	// adds one packet per run of submeshes with the same material and the same passes.
+	// subMeshPasses holds the passes of every submesh in Model::Cull order, submeshes without passes are skipped.
+	// instanceCount > 0 draws that many copies with the matrices written at instanceOffset of the uniform ring
+	void AddModel(Model& model, size_t objectOffset, const std::vector<unsigned int>& subMeshPasses, unsigned int variant, EDrawFilter drawClass, float depth,
+		size_t instanceOffset = 0, unsigned int instanceCount = 0);
+
+	// orders the packets by pass mask, shader variant, material and depth
+	void Sort();
+
+	// draws the packets taking part in pass and matching filter, in sort order. shaders maps every variant to the program
+	// of this pass, bindMaterials = false skips textures for passes that don't sample them (depth only)
+	void Submit(ERenderPass pass, Shader* const (&shaders)[SHADER_VARIANT_COUNT], const UniformRing& uniforms, bool bindMaterials, EDrawFilter filter = DRAW_ALL) const;
+
+	const std::vector<DrawPacket>& GetPackets() const { return packets; }
+
+private:
+	static uint64_t MakeSortKey(const DrawPacket& packet);
+
+	std::vector<DrawPacket> packets;
+};
+
+#endif
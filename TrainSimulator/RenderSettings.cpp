@@ -0,0 +1,143 @@
+#include "RenderSettings.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	bool ParseUnsigned(const char* text, unsigned int& value)
+	{
+		char* end = nullptr;
+		const unsigned long parsed = std::strtoul(text, &end, 10);
+		if (end == text || *end != '\0')
+			return false;
+		value = static_cast<unsigned int>(parsed);
+		return true;
+	}
+
+	bool ParseBool(const char* text, bool& value)
+	{
+		unsigned int parsed = 0;
+		if (!ParseUnsigned(text, parsed) || parsed > 1)
+			return false;
+		value = parsed != 0;
+		return true;
+	}
+
+	bool ParseFloat(const char* text, float& value)
+	{
+		char* end = nullptr;
+		const float parsed = std::strtof(text, &end);
+		if (end == text || *end != '\0')
+			return false;
+		value = parsed;
+		return true;
+	}
+}
+
+std::string RenderSettings::GetShadowFilterDefine() const
+{
+	if (shadowFilter == "poisson")
+		return "SHADOW_PCF_POISSON";
+	return "SHADOW_PCF_TAPS " + shadowFilter;
+}
+
+RenderSettings RenderSettings::FromCommandLine(int argc, char* argv[])
+{
+	RenderSettings settings;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string option = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool parsed = false;
+		bool known = true;
+
+		if (option == "--shadow-cascades")
+			parsed = value && ParseUnsigned(value, settings.shadowCascades);
+		else if (option == "--shadow-map-size")
+			parsed = value && ParseUnsigned(value, settings.shadowMapSize);
+		else if (option == "--shadow-distance")
+			parsed = value && ParseFloat(value, settings.shadowDistance);
+		else if (option == "--shadow-cache")
+			parsed = value && ParseBool(value, settings.shadowCache);
+		else if (option == "--shadow-filter")
+		{
+			parsed = value && (std::strcmp(value, "1") == 0 || std::strcmp(value, "4") == 0 || std::strcmp(value, "9") == 0 ||
+				std::strcmp(value, "16") == 0 || std::strcmp(value, "poisson") == 0);
+			if (parsed)
+				settings.shadowFilter = value;
+		}
+		else if (option == "--shadow-light-threshold")
+			parsed = value && ParseFloat(value, settings.shadowLightThreshold);
+		else if (option == "--depth-prepass")
+			parsed = value && ParseBool(value, settings.depthPrepass);
+		else if (option == "--wagons")
+			parsed = value && ParseUnsigned(value, settings.wagons);
+		else if (option == "--texture-anisotropy")
+			parsed = value && ParseFloat(value, settings.textureAnisotropy);
+		else if (option == "--indirect-draw")
+			parsed = value && ParseBool(value, settings.indirectDraw);
+		else if (option == "--texture-streaming")
+			parsed = value && ParseBool(value, settings.textureStreaming);
+		else if (option == "--texture-upload-mb")
+		{
+			// parsed aside so a rejected value keeps the default, a zero budget would never let the streamer finish
+			float uploadMB = 0.0f;
+			parsed = value && ParseFloat(value, uploadMB) && uploadMB > 0.0f;
+			if (parsed)
+				settings.textureUploadMB = uploadMB;
+		}
+		else if (option == "--texture-upload-ms")
+		{
+			float uploadMs = 0.0f;
+			parsed = value && ParseFloat(value, uploadMs) && uploadMs > 0.0f;
+			if (parsed)
+				settings.textureUploadMs = uploadMs;
+		}
+		else if (option == "--texture-budget-mb")
+		{
+			float budgetMB = 0.0f;
+			parsed = value && ParseFloat(value, budgetMB) && budgetMB >= 0.0f;
+			if (parsed)
+				settings.textureBudgetMB = budgetMB;
+		}
+		else if (option == "--shader-cache")
+			parsed = value && ParseBool(value, settings.shaderCache);
+		else if (option == "--compress-textures")
+		{
+			parsed = value != nullptr;
+			if (parsed)
+				settings.compressTextures = value;
+		}
+		else
+			known = false;
+
+		if (!known)
+		{
+			std::cout << "WARNING::RENDER_SETTINGS:: unknown option " << option << std::endl;
+			continue;
+		}
+		if (!parsed)
+			std::cout << "WARNING::RENDER_SETTINGS:: missing or invalid value for " << option << std::endl;
+		i++;
+	}
+
+	// keep everything in the range the renderer supports
+	if (settings.shadowCascades < 2 || settings.shadowCascades > 4)
+	{
+		std::cout << "WARNING::RENDER_SETTINGS:: shadow cascades must be between 2 and 4" << std::endl;
+		settings.shadowCascades = std::min(std::max(settings.shadowCascades, 2u), 4u);
+	}
+	settings.shadowMapSize = std::min(std::max(settings.shadowMapSize, 256u), 8192u);
+	settings.shadowDistance = std::max(settings.shadowDistance, 1.0f);
+	settings.shadowLightThreshold = std::max(settings.shadowLightThreshold, 0.0f);
+	settings.wagons = std::min(settings.wagons, 100u);
+	settings.textureAnisotropy = std::min(std::max(settings.textureAnisotropy, 1.0f), 16.0f);
+	settings.textureUploadMB = std::min(std::max(settings.textureUploadMB, 0.25f), 1024.0f);
+	settings.textureUploadMs = std::min(std::max(settings.textureUploadMs, 0.1f), 100.0f);
+	settings.textureBudgetMB = std::min(std::max(settings.textureBudgetMB, 0.0f), 65536.0f);
+	return settings;
+}
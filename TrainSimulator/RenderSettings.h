@@ -0,0 +1,33 @@
+#pragma once
+#ifndef RENDER_SETTINGS_H
+#define RENDER_SETTINGS_H
+
+#include <string>
+
+// renderer options chosen at startup, every one can be overridden from the command line ("--name value")
+struct RenderSettings {
+	unsigned int shadowCascades = 3;     // --shadow-cascades, 2 to 4 slices of the view frustum
+	unsigned int shadowMapSize = 2048;   // --shadow-map-size, resolution of every cascade
+	float shadowDistance = 1000.0f;      // --shadow-distance, the cascades cover the view frustum up to this distance
+	bool shadowCache = true;             // --shadow-cache 0|1, keep static casters in a cached shadow map
+	float shadowLightThreshold = 0.5f;   // --shadow-light-threshold, degrees the light turns before the cache is rebuilt
+	std::string shadowFilter = "9";      // --shadow-filter 1|4|9|16|poisson, hardware compared taps per shadow lookup
+	bool depthPrepass = false;           // --depth-prepass 0|1, lay down depth first so the main pass only shades visible fragments
+	unsigned int wagons = 0;             // --wagons, wagons behind the locomotive, drawn instanced
+	float textureAnisotropy = 8.0f;      // --texture-anisotropy, anisotropic filtering level of model textures, 1 for trilinear only
+	bool indirectDraw = true;            // --indirect-draw 0|1, draw static geometry with multi-draw indirect when the GPU has GL 4.3
+	bool textureStreaming = false;       // --texture-streaming 0|1, show the scene at once and stream model textures in afterwards
+	float textureUploadMB = 4.0f;        // --texture-upload-mb, most texture data streamed to the GPU per frame
+	float textureUploadMs = 2.0f;        // --texture-upload-ms, most time per frame spent uploading streamed textures
+	float textureBudgetMB = 0.0f;        // --texture-budget-mb, video memory model textures may use, top mips are dropped above it. 0 for no limit
+	bool shaderCache = true;             // --shader-cache 0|1, load linked programs from binaries saved by an earlier run
+	std::string compressTextures;        // --compress-textures <dir>, write block compressed copies of the images below dir and exit
+
+	// shader define selecting the shadow filter in ShadowMapping.fs
+	std::string GetShadowFilterDefine() const;
+
+	// parses the command line, unknown or invalid options are reported and keep their default
+	static RenderSettings FromCommandLine(int argc, char* argv[]);
+};
+
+#endif
@@ -1,9 +1,27 @@
 #include "Shader.h"
+#include "GLExtensions.h"
+#include "ProgramCache.h"
+#include "UniformBlocks.h"
+
+#include <chrono>
+
+#ifdef _DEBUG
+bool Shader::WarnOnUnknownUniforms = true;
+#else
+bool Shader::WarnOnUnknownUniforms = false;
+#endif
+bool Shader::UseProgramCache = true;
+Shader::BuildStats Shader::buildStats;
 
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
-	Init(vertexPath, fragmentPath);
+	Init(vertexPath, fragmentPath, {});
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
+{
+	Init(vertexPath, fragmentPath, defines);
 }
 
 Shader::~Shader()
@@ -21,33 +39,96 @@ unsigned int Shader::GetID() const
 	return ID;
 }
 
+int Shader::GetUniformLocation(const std::string& uniformName) const
+{
+	auto it = uniformLocations.find(uniformName);
+	if (it != uniformLocations.end())
+		return it->second;
+	if (WarnOnUnknownUniforms && unknownUniforms.insert(uniformName).second)
+		std::cout << "WARNING::SHADER::UNKNOWN_UNIFORM '" << uniformName << "' in " << name << std::endl;
+	return -1;
+}
+
+int Shader::FindUniformLocation(const std::string& uniformName) const
+{
+	auto it = uniformLocations.find(uniformName);
+	return it != uniformLocations.end() ? it->second : -1;
+}
+
 void Shader::SetVec3(const std::string& name, const glm::vec3& value) const
 {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform3fv(GetUniformLocation(name), 1, &value[0]);
 }
 
 void Shader::SetVec3(const std::string& name, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	glUniform3f(GetUniformLocation(name), x, y, z);
 }
 
 void Shader::SetFloat(const std::string& name, float fValue) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), fValue);
+	glUniform1f(GetUniformLocation(name), fValue);
 }
 
 void Shader::SetInt(const std::string& name, int iValue) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), iValue);
+	glUniform1i(GetUniformLocation(name), iValue);
 }
 
 void Shader::SetMat4(const std::string& name, const glm::mat4& mat) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::Set(Uniform<int> uniform, int value) const
+{
+	glUniform1i(uniform.location, value);
+}
+
+void Shader::Set(Uniform<float> uniform, float value) const
+{
+	glUniform1f(uniform.location, value);
+}
+
+void Shader::Set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+	glUniform3fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::Set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+{
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
 }
 
-void Shader::Init(const char* vertexPath, const char* fragmentPath)
+std::string Shader::InjectDefines(const std::string& source, const std::vector<std::string>& defines)
 {
+	if (defines.empty())
+		return source;
+
+	std::string block;
+	for (const std::string& define : defines)
+		block += "#define " + define + "\n";
+
+	// #version has to stay the first directive of the source
+	size_t insertAt = 0;
+	const size_t version = source.find("#version");
+	if (version != std::string::npos)
+	{
+		const size_t lineEnd = source.find('\n', version);
+		insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+	}
+	std::string result = source;
+	if (insertAt == result.size() && !result.empty() && result.back() != '\n')
+		result += '\n', insertAt++;
+	return result.insert(insertAt, block);
+}
+
+void Shader::Init(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
+{
+	name = std::string(vertexPath) + " + " + fragmentPath;
+	for (const std::string& define : defines)
+		name += " [" + define + "]";
+
 	// 1. retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -68,16 +149,45 @@ void Shader::Init(const char* vertexPath, const char* fragmentPath)
 		vShaderFile.close();
 		fShaderFile.close();
 		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		vertexCode = InjectDefines(vShaderStream.str(), defines);
+		fragmentCode = InjectDefines(fShaderStream.str(), defines);
 	}
 	catch (std::ifstream::failure e) {
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
+
+	// 2. load the program binary linked by an earlier run, or compile and link the sources and store the result
+	const std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+	const bool cacheable = UseProgramCache && GLExtensions::Instance().programBinary;
+	const uint64_t cacheKey = cacheable ? ProgramCache::MakeKey(vertexCode, fragmentCode) : 0;
+	const std::string cachePath = cacheable ? ProgramCache::GetCachePath(name) : std::string();
+	ID = glCreateProgram();
+	const bool fromCache = cacheable && ProgramCache::Load(cachePath, cacheKey, ID);
+	if (!fromCache)
+	{
+		// a rejected binary can leave the program in a failed state, link the sources into a fresh one
+		glDeleteProgram(ID);
+		ID = glCreateProgram();
+		if (CompileAndLink(vertexCode, fragmentCode, cacheable) && cacheable)
+			ProgramCache::Save(cachePath, cacheKey, ID);
+	}
+	const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+	buildStats.milliseconds += buildMs;
+	(fromCache ? buildStats.fromCache : buildStats.compiled)++;
+	std::cout << "Shader " << name << (fromCache ? " loaded from the program cache in " : " compiled in ") << buildMs << " ms" << std::endl;
+
+	// 3. resolve every uniform location once, so setting uniforms never needs a string lookup in the driver
+	CacheUniforms();
+	// 4. connect the shared uniform blocks (PerFrame, PerObject, ...) to their binding points
+	BindUniformBlocks(ID);
+}
+
+bool Shader::CompileAndLink(const std::string& vertexCode, const std::string& fragmentCode, bool retrievable)
+{
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	// 2. compile shaders
+	// compile shaders
 	unsigned int vertex, fragment;
 	// vertex shader
 	vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -89,16 +199,57 @@ void Shader::Init(const char* vertexPath, const char* fragmentPath)
 	glShaderSource(fragment, 1, &fShaderCode, NULL);
 	glCompileShader(fragment);
 	CheckCompileErrors(fragment, "FRAGMENT");
-	// shader Program
-	ID = glCreateProgram();
+	// shader Program, the binary has to be requested before linking to be retrievable afterwards
 	glAttachShader(ID, vertex);
 	glAttachShader(ID, fragment);
+	if (retrievable)
+		GLExtensions::Instance().ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(ID);
 	CheckCompileErrors(ID, "PROGRAM");
 
-	// 3. delete the shaders as they're linked into our program now and no longer necessery
+	// delete the shaders as they're linked into our program now and no longer necessery
+	glDetachShader(ID, vertex);
+	glDetachShader(ID, fragment);
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+	return linked == GL_TRUE;
+}
+
+void Shader::CacheUniforms()
+{
+	uniformLocations.clear();
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::string buffer(std::max(maxLength, 1), '\0');
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, i, static_cast<GLsizei>(buffer.size()), &length, &size, &type, &buffer[0]);
+		std::string uniformName(buffer.data(), length);
+		// uniforms inside blocks have no location
+		GLint location = glGetUniformLocation(ID, uniformName.c_str());
+		if (location < 0)
+			continue;
+		uniformLocations[uniformName] = location;
+		// arrays are reported as "name[0]", make every element reachable as "name[i]" and the array as "name"
+		const size_t bracket = uniformName.find("[0]");
+		if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+		{
+			const std::string base = uniformName.substr(0, bracket);
+			uniformLocations[base] = location;
+			for (GLint element = 1; element < size; element++)
+			{
+				const std::string elementName = base + "[" + std::to_string(element) + "]";
+				uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+			}
+		}
+	}
 }
 
 void Shader::CheckCompileErrors(unsigned int shader, std::string type)
@@ -4,6 +4,7 @@
 #include<sstream>
 #include<iostream>
 #include<cerrno>
+#include<algorithm>
 
 #include <stdlib.h> // necesare pentru citirea shader-elor
 #include <stdio.h>
@@ -19,6 +20,9 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #pragma comment (lib, "glfw3dll.lib")
 #pragma comment (lib, "glew32.lib")
@@ -27,10 +31,33 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+// Location of a uniform resolved once, typed by the value it accepts so it can only be set with a matching Set overload.
+template <typename T>
+struct Uniform
+{
+	int location = -1;
+};
+
 class Shader
 {
 public:
+	// when enabled, looking up a uniform the program doesn't declare prints a warning (once per name) instead of silently using -1
+	static bool WarnOnUnknownUniforms;
+
+	// when enabled (and the driver supports program binaries), linked programs are saved to and loaded from the ProgramCache
+	static bool UseProgramCache;
+
+	// how the programs built so far were obtained, to compare cold (compiled) and warm (cached) startups
+	struct BuildStats {
+		unsigned int compiled = 0;
+		unsigned int fromCache = 0;
+		double milliseconds = 0.0;
+	};
+	static const BuildStats& GetBuildStats() { return buildStats; }
+
 	Shader(const char* vertexPath, const char* fragmentPath);
+	// builds a variant of the program, every define is injected as "#define <define>" right after the #version line of both stages
+	Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines);
 	~Shader();
 
 	// activate the shaderStencilTesting
@@ -45,6 +72,18 @@ public:
 	unsigned int loc_projection_matrix;
 
 
+	// uniform locations, served from the table built after linking (no driver call).
+	// GetUniformLocation warns about unknown names in debug mode, FindUniformLocation is for optional uniforms.
+	int GetUniformLocation(const std::string& name) const;
+	int FindUniformLocation(const std::string& name) const;
+
+	// pre-resolved uniform handle, look it up once and reuse it every frame
+	template <typename T>
+	Uniform<T> GetUniform(const std::string& name) const
+	{
+		return Uniform<T>{ GetUniformLocation(name) };
+	}
+
 	// utility uniform functions
 	void SetInt(const std::string& name, int value) const;
 	void SetFloat(const std::string& name, float value) const;
@@ -52,14 +91,34 @@ public:
 	void SetVec3(const std::string& name, float x, float y, float z) const;
 	void SetMat4(const std::string& name, const glm::mat4& mat) const;
 
+	// the same through pre-resolved handles, for the per-frame hot path
+	void Set(Uniform<int> uniform, int value) const;
+	void Set(Uniform<float> uniform, float value) const;
+	void Set(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+	void Set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+
 private:
-	void Init(const char* vertexPath, const char* fragmentPath);
+	void Init(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines);
+
+	// compiles both stages and links them into ID, returns false if linking failed
+	bool CompileAndLink(const std::string& vertexCode, const std::string& fragmentCode, bool retrievable);
+
+	// inserts the defines after the #version directive (or at the top when there is none)
+	static std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines);
 
 	// utility function for checking shaderStencilTesting compilation/linking errors.
 	// ------------------------------------------------------------------------
 	void CheckCompileErrors(unsigned int shaderStencilTesting, std::string type);
 
+	// reflects every active uniform of the linked program into uniformLocations
+	void CacheUniforms();
+
 private:
 	unsigned int ID;
+	std::string name;
+	std::unordered_map<std::string, int> uniformLocations;
+	mutable std::unordered_set<std::string> unknownUniforms;
+
+	static BuildStats buildStats;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "ShadowCascades.h"
+
+#include <gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// blend between logarithmic (1) and uniform (0) split distances
+	const float SPLIT_LAMBDA = 0.75f;
+}
+
+ShadowCascades::ShadowCascades(unsigned int resolution, unsigned int cascadeCount, bool cacheStatic, float lightThresholdDegrees) :
+	resolution(resolution), cascadeCount(std::min(std::max(cascadeCount, 1u), MAX_SHADOW_CASCADES)), lightDirection(0.0f),
+	lightThresholdCos(std::cos(glm::radians(lightThresholdDegrees))), cacheStatic(cacheStatic), staticDepthTexture(0), staticFBO(0),
+	staticRebuilds(0)
+{
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		matrices[i] = glm::mat4(1.0f);
+		cachedMatrices[i] = glm::mat4(1.0f);
+		splitDepths[i] = 0.0f;
+		cacheValid[i] = false;
+	}
+
+	// the layer is attached when a cascade is rendered
+	depthTexture = createDepthArray(true);
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::SHADOW_CASCADES:: framebuffer is not complete" << std::endl;
+
+	if (cacheStatic)
+	{
+		staticDepthTexture = createDepthArray(false);
+		glGenFramebuffers(1, &staticFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, staticFBO);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticDepthTexture, 0, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::SHADOW_CASCADES:: static cache framebuffer is not complete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ShadowCascades::~ShadowCascades()
+{
+	if (cacheStatic)
+	{
+		glDeleteFramebuffers(1, &staticFBO);
+		glDeleteTextures(1, &staticDepthTexture);
+	}
+	glDeleteFramebuffers(1, &FBO);
+	glDeleteTextures(1, &depthTexture);
+}
+
+unsigned int ShadowCascades::createDepthArray(bool comparison) const
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	const GLint filter = comparison ? GL_LINEAR : GL_NEAREST;
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+	if (comparison)
+	{
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return texture;
+}
+
+void ShadowCascades::Update(const glm::mat4& cameraView, float fovY, float aspect, float nearPlane, float shadowDistance,
+	const glm::vec3& directionToLight, const AABB& casterBounds)
+{
+	const glm::mat4 inverseView = glm::inverse(cameraView);
+	const float tanHalfFov = std::tan(fovY * 0.5f);
+
+	// small light movements are ignored so the matrices, and with them the static cache, stay the same
+	const glm::vec3 newDirection = glm::normalize(directionToLight);
+	if (glm::dot(newDirection, lightDirection) < lightThresholdCos)
+		lightDirection = newDirection;
+
+	// one fixed light orientation for every cascade (only the projections move), looking along the light rays
+	const glm::vec3 lightDir = lightDirection;
+	const glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	const glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), -lightDir, up);
+
+	// depth range of every caster in light space, the light looks down -z
+	float casterNear = FLT_MAX, casterFar = -FLT_MAX;
+	if (casterBounds.IsValid())
+	{
+		const AABB lightBounds = casterBounds.Transform(lightView);
+		casterNear = -lightBounds.max.z;
+		casterFar = -lightBounds.min.z;
+	}
+
+	float sliceNear = nearPlane;
+	for (unsigned int cascade = 0; cascade < cascadeCount; cascade++)
+	{
+		// practical split scheme
+		const float p = static_cast<float>(cascade + 1) / cascadeCount;
+		const float logSplit = nearPlane * std::pow(shadowDistance / nearPlane, p);
+		const float uniformSplit = nearPlane + (shadowDistance - nearPlane) * p;
+		const float sliceFar = SPLIT_LAMBDA * logSplit + (1.0f - SPLIT_LAMBDA) * uniformSplit;
+
+		// the 8 corners of the slice in world space
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const float depth = (corner & 4) ? sliceFar : sliceNear;
+			const float halfHeight = depth * tanHalfFov;
+			const float halfWidth = halfHeight * aspect;
+			const glm::vec4 viewCorner((corner & 1) ? halfWidth : -halfWidth, (corner & 2) ? halfHeight : -halfHeight, -depth, 1.0f);
+			corners[corner] = glm::vec3(inverseView * viewCorner);
+			center += corners[corner];
+		}
+		center /= 8.0f;
+
+		// bounding sphere of the slice, rounded so its size doesn't jitter with float noise
+		float radius = 0.0f;
+		for (const glm::vec3& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// snap the center to whole texels of the cascade
+		const float texelSize = 2.0f * radius / resolution;
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+		lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+		// the depth range covers the slice and every caster between it and the light, but nothing behind the last caster
+		float zNear = -lightCenter.z - radius;
+		float zFar = -lightCenter.z + radius;
+		if (casterBounds.IsValid())
+		{
+			zNear = std::min(zNear, casterNear);
+			zFar = std::min(zFar, casterFar);
+		}
+		zFar = std::max(zFar, zNear + 1.0f);
+		// round the range outwards to steps of the cascade size, so it doesn't change a little every frame
+		const float depthStep = std::max(radius * 0.25f, 1.0f);
+		zNear = std::floor(zNear / depthStep) * depthStep;
+		zFar = std::ceil(zFar / depthStep) * depthStep;
+
+		const glm::mat4 lightProjection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+			lightCenter.y - radius, lightCenter.y + radius, zNear, zFar);
+		matrices[cascade] = lightProjection * lightView;
+		splitDepths[cascade] = sliceFar;
+		sliceNear = sliceFar;
+	}
+}
+
+void ShadowCascades::FillFrameBlock(PerFrameBlock& block) const
+{
+	for (unsigned int cascade = 0; cascade < MAX_SHADOW_CASCADES; cascade++)
+	{
+		block.lightSpaceMatrices[cascade] = matrices[cascade];
+		block.cascadeSplits[cascade] = cascade < cascadeCount ? splitDepths[cascade] : 0.0f;
+	}
+	block.cascadeCount = static_cast<int>(cascadeCount);
+}
+
+bool ShadowCascades::NeedsStaticRebuild(unsigned int cascade) const
+{
+	return !cacheStatic || !cacheValid[cascade] || cachedMatrices[cascade] != matrices[cascade];
+}
+
+void ShadowCascades::BeginStaticCascade(unsigned int cascade) const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, cacheStatic ? staticFBO : FBO);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cacheStatic ? staticDepthTexture : depthTexture, 0, cascade);
+	glViewport(0, 0, resolution, resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowCascades::EndStaticCascade(unsigned int cascade)
+{
+	staticRebuilds++;
+	if (!cacheStatic)
+		return;
+	cachedMatrices[cascade] = matrices[cascade];
+	cacheValid[cascade] = true;
+}
+
+void ShadowCascades::BeginCascade(unsigned int cascade) const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+	glViewport(0, 0, resolution, resolution);
+	if (!cacheStatic)
+		return; // BeginStaticCascade already cleared this layer and drew the static casters into it
+
+	// start from the cached static casters
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFBO);
+	glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticDepthTexture, 0, cascade);
+	glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+}
+
+void ShadowCascades::InvalidateStaticCache()
+{
+	for (bool& valid : cacheValid)
+		valid = false;
+}
+
+unsigned int ShadowCascades::TakeStaticRebuildCount()
+{
+	const unsigned int count = staticRebuilds;
+	staticRebuilds = 0;
+	return count;
+}
+
+void ShadowCascades::End() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowCascades::BindTexture() const
+{
+	glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include "Bounds.h"
+#include "UniformBlocks.h"
+
+// texture unit of the shadow map array, above the units meshes bind their textures to
+const unsigned int SHADOW_MAP_TEXTURE_UNIT = 15;
+
+// Cascaded shadow maps for a directional light, one layer of a depth texture array per cascade.
+// The view frustum up to the shadow distance is split in slices (practical split scheme), every cascade gets an
+// orthographic projection around the bounding sphere of its slice. The sphere keeps the projection size constant
+// while the camera turns and the center is snapped to whole shadow map texels, so shadow edges don't shimmer.
+//
+// With the static cache enabled, static casters are rendered into a second texture array that is only redrawn
+// when the matrix of a cascade changes (the snapped center or depth range moved, or the light turned more than
+// lightThresholdDegrees). Every frame that layer is copied into the working layer and only dynamic casters are
+// drawn on top of it.
+class ShadowCascades
+{
+public:
+	ShadowCascades(unsigned int resolution, unsigned int cascadeCount, bool cacheStatic = true, float lightThresholdDegrees = 0.5f);
+	~ShadowCascades();
+
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+	// fits every cascade to its slice of the camera frustum [nearPlane, shadowDistance].
+	// directionToLight points from the scene towards the light, casterBounds (world space) sets the depth range
+	// so casters outside the slice still land in the map
+	void Update(const glm::mat4& cameraView, float fovY, float aspect, float nearPlane, float shadowDistance,
+		const glm::vec3& directionToLight, const AABB& casterBounds);
+
+	// fills the cascade part of the PerFrame block
+	void FillFrameBlock(PerFrameBlock& block) const;
+
+	// true when the static casters of a cascade have to be rendered again (always true without the cache)
+	bool NeedsStaticRebuild(unsigned int cascade) const;
+
+	// binds the framebuffer to the static cache layer of a cascade, sets the viewport and clears it.
+	// after drawing the static casters call EndStaticCascade to mark the layer as valid
+	void BeginStaticCascade(unsigned int cascade) const;
+	void EndStaticCascade(unsigned int cascade);
+
+	// binds the framebuffer to the working layer of a cascade and sets the viewport. with the cache the layer
+	// starts as a copy of the static casters, without it the layer is cleared
+	void BeginCascade(unsigned int cascade) const;
+
+	// forgets every cached static layer (static geometry changed)
+	void InvalidateStaticCache();
+
+	bool IsStaticCacheEnabled() const { return cacheStatic; }
+
+	// number of static layers rebuilt since the last call, for the statistics
+	unsigned int TakeStaticRebuildCount();
+
+	// binds the default framebuffer again
+	void End() const;
+
+	// binds the depth texture array to SHADOW_MAP_TEXTURE_UNIT
+	void BindTexture() const;
+
+	unsigned int GetCascadeCount() const { return cascadeCount; }
+	unsigned int GetResolution() const { return resolution; }
+	const glm::mat4& GetMatrix(unsigned int cascade) const { return matrices[cascade]; }
+	float GetSplitDepth(unsigned int cascade) const { return splitDepths[cascade]; }
+
+private:
+	// creates a depth texture array with one layer per cascade. a comparison array is sampled through
+	// sampler2DArrayShadow with bilinear filtering, every lookup returning the lit fraction of 4 texels
+	unsigned int createDepthArray(bool comparison) const;
+
+	unsigned int resolution;
+	unsigned int cascadeCount;
+	unsigned int depthTexture;
+	unsigned int FBO;
+	glm::mat4 matrices[MAX_SHADOW_CASCADES];
+	float splitDepths[MAX_SHADOW_CASCADES];
+
+	// light direction the matrices are built with, only follows the real one past the threshold
+	glm::vec3 lightDirection;
+	float lightThresholdCos;
+
+	// static caster cache
+	bool cacheStatic;
+	unsigned int staticDepthTexture;
+	unsigned int staticFBO;
+	glm::mat4 cachedMatrices[MAX_SHADOW_CASCADES];
+	bool cacheValid[MAX_SHADOW_CASCADES];
+	unsigned int staticRebuilds;
+};
+
+#endif
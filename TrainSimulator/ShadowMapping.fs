@@ -5,63 +5,129 @@ in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec4 FragPosLightSpace;
 } fs_in;
 
+#ifdef TEXTURE_ARRAY
+// packed textures, the layer comes from the vertex shader
+uniform sampler2DArray diffuseArray;
+flat in int DiffuseLayer;
+#else
 uniform sampler2D diffuseTexture;
-uniform sampler2D shadowMap;
+#endif
+uniform sampler2DArrayShadow shadowMap;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+layout (std140) uniform PerFrame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrices[4]; // one per shadow cascade
+    vec4 cascadeSplits;         // view space distance where each cascade ends
+    vec3 viewPos;
+    float ambientStrength;
+    vec3 lightPos;
+    float diffuseStrength;
+    float specularStrength;
+    int cascadeCount;
+};
+
+// the first cascade whose slice of the view frustum contains the fragment, cascadeCount when it is beyond the shadow distance
+int SelectCascade(vec3 fragPos)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    for (int i = 0; i < cascadeCount; ++i)
+    {
+        if (viewDepth < cascadeSplits[i])
+            return i;
+    }
+    return cascadeCount;
+}
+
+// the filter is chosen at startup: SHADOW_PCF_TAPS 1, 4, 9 or 16 hardware compared taps on a grid, or SHADOW_PCF_POISSON
+// for 16 taps on a Poisson disc. every tap is a bilinear comparison of 4 texels done by the texture unit
+#ifndef SHADOW_PCF_TAPS
+#ifdef SHADOW_PCF_POISSON
+#define SHADOW_PCF_TAPS 16
+#else
+#define SHADOW_PCF_TAPS 9
+#endif
+#endif
+
+#ifdef SHADOW_PCF_POISSON
+const vec2 poissonDisk[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725),
+    vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464),
+    vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+    vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420),
+    vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+    vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590),
+    vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+#endif
+
+// fraction of the light reaching the fragment, summed over the taps of the filter
+float SampleShadowMap(vec2 uv, float layer, float reference, vec2 texelSize)
+{
+#if defined(SHADOW_PCF_POISSON)
+    float lit = 0.0;
+    for (int i = 0; i < 16; ++i)
+        lit += texture(shadowMap, vec4(uv + poissonDisk[i] * texelSize * 1.5, layer, reference));
+    return lit / 16.0;
+#elif SHADOW_PCF_TAPS == 1
+    return texture(shadowMap, vec4(uv, layer, reference));
+#elif SHADOW_PCF_TAPS == 4
+    // 2x2 bilinear taps half a texel apart cover a 3x3 texel footprint
+    float lit = 0.0;
+    for (int x = 0; x < 2; ++x)
+        for (int y = 0; y < 2; ++y)
+            lit += texture(shadowMap, vec4(uv + (vec2(x, y) - 0.5) * texelSize, layer, reference));
+    return lit / 4.0;
+#elif SHADOW_PCF_TAPS == 16
+    float lit = 0.0;
+    for (int x = 0; x < 4; ++x)
+        for (int y = 0; y < 4; ++y)
+            lit += texture(shadowMap, vec4(uv + (vec2(x, y) - 1.5) * texelSize, layer, reference));
+    return lit / 16.0;
+#else
+    float lit = 0.0;
+    for (int x = -1; x <= 1; ++x)
+        for (int y = -1; y <= 1; ++y)
+            lit += texture(shadowMap, vec4(uv + vec2(x, y) * texelSize, layer, reference));
+    return lit / 9.0;
+#endif
+}
 
-float ShadowCalculation(vec4 fragPosLightSpace)
+float ShadowCalculation(vec3 fragPos)
 {
+    int cascade = SelectCascade(fragPos);
+    if (cascade >= cascadeCount)
+        return 0.0; // beyond the last cascade, no shadow information
+
+    vec4 fragPosLightSpace = lightSpaceMatrices[cascade] * vec4(fragPos, 1.0);
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
-    // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
-    // get depth of current fragment from light's perspective
-    float currentDepth = projCoords.z;
-    // calculate bias (based on depth map resolution and slope)
+    if (projCoords.z > 1.0)
+        return 0.0; // depth is out of light's perspective's range
+
+    // calculate bias (based on depth map resolution and slope), cascades are fitted tightly so their depth range is small
     vec3 normal = normalize(fs_in.Normal);
     vec3 lightDir = normalize(lightPos - fs_in.FragPos);
+    float bias = max(0.005 * (1.0 - dot(normal, lightDir)), 0.0005);
 
-    //float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-
-    //float shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
-       
-    //if(projCoords.z > 1.0)
-    //    shadow = 0.0; // depth is out of light's perspective's range
-
-    float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-
-    for(int x = -1; x <= 1; ++x)
-    {
-        for(int y = -1; y <= 1; ++y)
-        {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
-            shadow += currentDepth - bias > pcfDepth  ? 1.0 : 0.0;        
-        }
-    }
-    shadow /= 9.0;
-
-    if(projCoords.z > 1.0)
-        shadow = 0.0; // depth is out of light's perspective's range
-    
-    return shadow;
+    // the texture unit compares the biased depth of the fragment with the map (lit when it is nearer or equal)
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    return 1.0 - SampleShadowMap(projCoords.xy, float(cascade), projCoords.z - bias, texelSize);
 }
 
-  uniform float ambientStrength;
-  uniform float diffuseStrength;
-  uniform float specularStrength;
-
 void main()
 {           
+#ifdef TEXTURE_ARRAY
+    vec3 color = texture(diffuseArray, vec3(fs_in.TexCoords, DiffuseLayer)).rgb;
+#else
     vec3 color = texture(diffuseTexture, fs_in.TexCoords).rgb;
+#endif
     vec3 normal = normalize(fs_in.Normal);
     vec3 lightColor = vec3(0.3);
     // ambient
@@ -79,7 +145,7 @@ void main()
     vec3 specular = specularStrength * spec * lightColor;    
     
     // calculate shadow
-    float shadow = ShadowCalculation(fs_in.FragPosLightSpace);                      
+    float shadow = ShadowCalculation(fs_in.FragPos);                      
     vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;    
     
     FragColor = vec4(lighting, 1.0);
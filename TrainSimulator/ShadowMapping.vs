@@ -2,6 +2,18 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef INSTANCED
+layout (location = 7) in mat4 aInstanceModel; // locations 7 to 10, replaces model for every instance
+#endif
+#ifdef TEXTURE_ARRAY
+// layer of the diffuse texture in the bound texture array, per draw slot for instanced draws
+#ifdef INSTANCED
+layout (location = 11) in float aInstanceLayer;
+#else
+uniform int diffuseLayer;
+#endif
+flat out int DiffuseLayer;
+#endif
 
 out vec2 TexCoords;
 
@@ -9,19 +21,52 @@ out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
-    vec4 FragPosLightSpace;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
-uniform mat4 lightSpaceMatrix;
+layout (std140) uniform PerFrame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrices[4]; // one per shadow cascade
+    vec4 cascadeSplits;         // view space distance where each cascade ends
+    vec3 viewPos;
+    float ambientStrength;
+    vec3 lightPos;
+    float diffuseStrength;
+    float specularStrength;
+    int cascadeCount;
+};
+
+layout (std140) uniform PerObject
+{
+    mat4 model;
+    mat4 normalMatrix; // upper 3x3 is transpose(inverse(mat3(model))), computed once per object on the CPU
+};
+
+// must match the depth pre-pass (ShadowMappingDepth.vs with CAMERA_DEPTH) exactly for the GL_EQUAL depth test
+invariant gl_Position;
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
+#ifdef INSTANCED
+    mat4 world = aInstanceModel;
+#else
+    mat4 world = model;
+#endif
+    vs_out.FragPos = vec3(world * vec4(aPos, 1.0));
+#if defined(UNIFORM_SCALE) || defined(INSTANCED)
+    // uniform scale keeps normals perpendicular, the fragment shader renormalizes them
+    vs_out.Normal = mat3(world) * aNormal;
+#else
+    vs_out.Normal = mat3(normalMatrix) * aNormal;
+#endif
     vs_out.TexCoords = aTexCoords;
-    vs_out.FragPosLightSpace = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0);
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef TEXTURE_ARRAY
+#ifdef INSTANCED
+    DiffuseLayer = int(aInstanceLayer);
+#else
+    DiffuseLayer = diffuseLayer;
+#endif
+#endif
+    gl_Position = projection * view * world * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #version 330 core
 
 void main()
-{             
-    gl_FragDepth = gl_FragCoord.z;
+{
+    // the rasterized depth is written as is, leaving gl_FragDepth alone keeps early depth testing enabled
 }
\ No newline at end of file
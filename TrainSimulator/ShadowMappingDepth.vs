@@ -1,10 +1,47 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+layout (location = 7) in mat4 aInstanceModel; // locations 7 to 10, replaces model for every instance
+#endif
 
-uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+layout (std140) uniform PerFrame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrices[4]; // one per shadow cascade
+    vec4 cascadeSplits;         // view space distance where each cascade ends
+    vec3 viewPos;
+    float ambientStrength;
+    vec3 lightPos;
+    float diffuseStrength;
+    float specularStrength;
+    int cascadeCount;
+};
+
+layout (std140) uniform PerObject
+{
+    mat4 model;
+    mat4 normalMatrix; // upper 3x3 is transpose(inverse(mat3(model))), computed once per object on the CPU
+};
+
+// cascade being rendered, selects its light matrix
+uniform int cascadeIndex;
+
+#ifdef CAMERA_DEPTH
+// depth pre-pass: the main pass tests with GL_EQUAL, so the position has to be bit identical to ShadowMapping.vs
+invariant gl_Position;
+#endif
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+#ifdef INSTANCED
+    mat4 world = aInstanceModel;
+#else
+    mat4 world = model;
+#endif
+#ifdef CAMERA_DEPTH
+    gl_Position = projection * view * world * vec4(aPos, 1.0);
+#else
+    gl_Position = lightSpaceMatrices[cascadeIndex] * world * vec4(aPos, 1.0);
+#endif
 }
\ No newline at end of file
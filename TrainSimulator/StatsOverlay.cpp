@@ -0,0 +1,72 @@
+#include "StatsOverlay.h"
+
+#include <stb_easy_font.h>
+
+namespace
+{
+	// stb_easy_font vertex: x, y, z as floats then an RGBA8 color
+	const unsigned int VERTEX_SIZE = 3 * sizeof(float) + 4;
+}
+
+StatsOverlay::StatsOverlay(unsigned int screenWidth, unsigned int screenHeight) :
+	shader("StatsOverlay.vs", "StatsOverlay.fs"), vertexData(MAX_QUADS * 4 * VERTEX_SIZE)
+{
+	shader.Use();
+	glUniform2f(shader.GetUniformLocation("screenSize"), static_cast<float>(screenWidth), static_cast<float>(screenHeight));
+
+	// the font is made of quads, core profile draws them as two triangles each
+	std::vector<unsigned int> indices;
+	indices.reserve(MAX_QUADS * 6);
+	for (unsigned int quad = 0; quad < MAX_QUADS; quad++)
+	{
+		const unsigned int first = quad * 4;
+		indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexData.size(), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, VERTEX_SIZE, (void*)(3 * sizeof(float)));
+	glBindVertexArray(0);
+}
+
+StatsOverlay::~StatsOverlay()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+void StatsOverlay::Draw(const std::string& text, float x, float y, float scale)
+{
+	// stb_easy_font wants a mutable, null terminated string
+	textBuffer.assign(text.begin(), text.end());
+	textBuffer.push_back('\0');
+	unsigned char color[4] = { 255, 255, 0, 255 };
+	const int quads = stb_easy_font_print(0.0f, 0.0f, textBuffer.data(), color, vertexData.data(), static_cast<int>(vertexData.size()));
+	if (quads <= 0)
+		return;
+
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	shader.Use();
+	glUniform2f(shader.GetUniformLocation("origin"), x, y);
+	glUniform1f(shader.GetUniformLocation("scale"), scale);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, quads * 4 * VERTEX_SIZE, vertexData.data());
+	glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, (void*)0);
+	glBindVertexArray(0);
+
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+}
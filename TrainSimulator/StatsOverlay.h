@@ -0,0 +1,34 @@
+#pragma once
+#ifndef STATS_OVERLAY_H
+#define STATS_OVERLAY_H
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+
+#include <string>
+#include <vector>
+
+// draws a few lines of text over the frame with stb_easy_font (no font texture, just colored quads)
+class StatsOverlay
+{
+public:
+	StatsOverlay(unsigned int screenWidth, unsigned int screenHeight);
+	~StatsOverlay();
+
+	StatsOverlay(const StatsOverlay&) = delete;
+	StatsOverlay& operator=(const StatsOverlay&) = delete;
+
+	// draws text with its top left corner at (x, y) pixels, '\n' starts a new line
+	void Draw(const std::string& text, float x = 10.0f, float y = 10.0f, float scale = 2.0f);
+
+private:
+	static const unsigned int MAX_QUADS = 8192;
+
+	Shader shader;
+	unsigned int VAO, VBO, EBO;
+	std::vector<char> vertexData;
+	std::vector<char> textBuffer;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+out vec4 Color;
+
+uniform vec2 screenSize;
+uniform vec2 origin;
+uniform float scale;
+
+// stb_easy_font positions are pixels with y going down
+void main()
+{
+    vec2 pixel = origin + aPos.xy * scale;
+    gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+    Color = aColor;
+}
@@ -1,7 +1,16 @@
 #pragma once
 #include <string>
+#include "TextureRegistry.h"
+
+// a layer of a GL_TEXTURE_2D_ARRAY, filled by TexturePacker
+struct TextureLayer {
+    unsigned int array = 0;
+    int layer = -1;
+};
+
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
+    TextureHandle handle; // keeps the GL texture alive in the TextureRegistry
 };
\ No newline at end of file
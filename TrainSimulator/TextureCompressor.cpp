@@ -0,0 +1,339 @@
+#include "TextureCompressor.h"
+
+#include "GLExtensions.h"
+#include "TextureLoader.h"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// stb_dxt expects memcpy to be declared already
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize2.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // the parts of the DDS format the encoder writes: legacy header, FourCC pixel format, full mip chain
+    const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+    // largest texture we accept from a header, the GL_MAX_TEXTURE_SIZE of current desktop GPUs
+    const uint32_t MAX_TEXTURE_SIZE = 16384;
+
+    struct DDSPixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+    };
+
+    struct DDSHeader {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DDSPixelFormat pixelFormat;
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+    static_assert(sizeof(DDSHeader) == 124, "DDSHeader must match the DDS file layout");
+
+    constexpr uint32_t FourCC(char a, char b, char c, char d)
+    {
+        return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+    }
+
+    // ATI1/ATI2 are the usual FourCCs of BC4/BC5
+    const uint32_t FORMAT_FOURCC[] = { FourCC('D', 'X', 'T', '1'), FourCC('D', 'X', 'T', '5'), FourCC('A', 'T', 'I', '1'), FourCC('A', 'T', 'I', '2') };
+
+    unsigned int BlockSize(EBlockFormat format)
+    {
+        return format == EBlockFormat::BC1 || format == EBlockFormat::BC4 ? 8 : 16;
+    }
+
+    // channels the encoder reads per pixel for a format
+    int FormatChannels(EBlockFormat format)
+    {
+        switch (format)
+        {
+        case EBlockFormat::BC4: return 1;
+        case EBlockFormat::BC5: return 2;
+        default: return 4;
+        }
+    }
+
+    size_t LevelSize(EBlockFormat format, int width, int height)
+    {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+    }
+
+    // encodes one mip level, blocks on the right/bottom edge repeat the last row/column
+    std::vector<unsigned char> EncodeLevel(const unsigned char* pixels, int width, int height, EBlockFormat format)
+    {
+        const int channels = FormatChannels(format);
+        std::vector<unsigned char> blocks(LevelSize(format, width, height));
+        unsigned char* out = blocks.data();
+        unsigned char block[16 * 4];
+        for (int by = 0; by < height; by += 4)
+        {
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                for (int y = 0; y < 4; y++)
+                {
+                    for (int x = 0; x < 4; x++)
+                    {
+                        const int px = std::min(bx + x, width - 1);
+                        const int py = std::min(by + y, height - 1);
+                        std::memcpy(block + (y * 4 + x) * channels, pixels + (static_cast<size_t>(py) * width + px) * channels, channels);
+                    }
+                }
+                switch (format)
+                {
+                case EBlockFormat::BC1: stb_compress_dxt_block(out, block, 0, STB_DXT_HIGHQUAL); break;
+                case EBlockFormat::BC3: stb_compress_dxt_block(out, block, 1, STB_DXT_HIGHQUAL); break;
+                case EBlockFormat::BC4: stb_compress_bc4_block(out, block); break;
+                case EBlockFormat::BC5: stb_compress_bc5_block(out, block); break;
+                }
+                out += BlockSize(format);
+            }
+        }
+        return blocks;
+    }
+
+    bool IsImageFile(const fs::path& path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+    }
+
+}
+
+std::string TextureCompressor::GetCompressedPath(const std::string& imagePath)
+{
+    return imagePath + ".dds";
+}
+
+bool TextureCompressor::HasCompressed(const std::string& imagePath)
+{
+    std::error_code error;
+    const fs::file_time_type compressedTime = fs::last_write_time(GetCompressedPath(imagePath), error);
+    if (error)
+        return false;
+    const fs::file_time_type imageTime = fs::last_write_time(imagePath, error);
+    return !error && compressedTime >= imageTime;
+}
+
+bool TextureCompressor::Compress(const std::string& imagePath)
+{
+    int width, height, channels;
+    if (!stbi_info(imagePath.c_str(), &width, &height, &channels))
+    {
+        std::cout << "ERROR::TEXTURE_COMPRESSOR:: can't read " << imagePath << std::endl;
+        return false;
+    }
+
+    // grayscale maps keep their one or two channels, everything else is encoded as RGBA
+    const int loadChannels = channels <= 2 ? channels : 4;
+    unsigned char* pixels = stbi_load(imagePath.c_str(), &width, &height, &channels, loadChannels);
+    if (!pixels)
+    {
+        std::cout << "ERROR::TEXTURE_COMPRESSOR:: can't decode " << imagePath << std::endl;
+        return false;
+    }
+
+    EBlockFormat format = EBlockFormat::BC1;
+    if (loadChannels == 1)
+        format = EBlockFormat::BC4;
+    else if (loadChannels == 2)
+        format = EBlockFormat::BC5;
+    else if (channels == 4)
+    {
+        // BC1 halves the size again, only keep BC3 when the alpha channel is actually used
+        const size_t pixelCount = static_cast<size_t>(width) * height;
+        for (size_t i = 0; i < pixelCount && format == EBlockFormat::BC1; i++)
+            if (pixels[i * 4 + 3] != 255)
+                format = EBlockFormat::BC3;
+    }
+
+    // the mip chain is filtered from the full resolution image every level, not from the previous level
+    const stbir_pixel_layout layout = loadChannels == 1 ? STBIR_1CHANNEL : (loadChannels == 2 ? STBIR_2CHANNEL : STBIR_RGBA);
+    CompressedImage image;
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    image.levels.push_back(EncodeLevel(pixels, width, height, format));
+    std::vector<unsigned char> level;
+    int levelWidth = width, levelHeight = height;
+    while (levelWidth > 1 || levelHeight > 1)
+    {
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+        level.resize(static_cast<size_t>(levelWidth) * levelHeight * loadChannels);
+        stbir_resize_uint8_linear(pixels, width, height, 0, level.data(), levelWidth, levelHeight, 0, layout);
+        image.levels.push_back(EncodeLevel(level.data(), levelWidth, levelHeight, format));
+    }
+    stbi_image_free(pixels);
+
+    DDSHeader header = {};
+    header.size = sizeof(DDSHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height = height;
+    header.width = width;
+    header.pitchOrLinearSize = static_cast<uint32_t>(image.levels[0].size());
+    header.mipMapCount = static_cast<uint32_t>(image.levels.size());
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = FORMAT_FOURCC[static_cast<int>(format)];
+    header.caps[0] = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+    const std::string compressedPath = GetCompressedPath(imagePath);
+    std::ofstream file(compressedPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::vector<unsigned char>& blocks : image.levels)
+        file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+    if (!file)
+    {
+        std::cout << "ERROR::TEXTURE_COMPRESSOR:: can't write " << compressedPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+unsigned int TextureCompressor::CompressDirectory(const std::string& directory)
+{
+    unsigned int written = 0;
+    std::error_code error;
+    for (fs::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+    {
+        if (!it->is_regular_file() || !IsImageFile(it->path()))
+            continue;
+        const std::string path = it->path().generic_string();
+        if (HasCompressed(path))
+            continue;
+        std::cout << "Compressing " << path << std::endl;
+        if (Compress(path))
+            written++;
+    }
+    if (error)
+        std::cout << "ERROR::TEXTURE_COMPRESSOR:: can't list " << directory << ": " << error.message() << std::endl;
+    return written;
+}
+
+bool TextureCompressor::Load(const std::string& ddsPath, CompressedImage& image)
+{
+    std::ifstream file(ddsPath, std::ios::binary);
+    uint32_t magic = 0;
+    DDSHeader header = {};
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || magic != DDS_MAGIC || header.size != sizeof(DDSHeader) || (header.pixelFormat.flags & DDPF_FOURCC) == 0)
+        return false;
+
+    const uint32_t* format = std::find(std::begin(FORMAT_FOURCC), std::end(FORMAT_FOURCC), header.pixelFormat.fourCC);
+    if (format == std::end(FORMAT_FOURCC) || header.width == 0 || header.height == 0)
+        return false;
+    // a corrupt header must not make the loader threads allocate gigabytes
+    if (header.width > MAX_TEXTURE_SIZE || header.height > MAX_TEXTURE_SIZE)
+    {
+        std::cout << "ERROR::TEXTURE_COMPRESSOR:: " << ddsPath << " is " << header.width << "x" << header.height << ", larger than "
+            << MAX_TEXTURE_SIZE << std::endl;
+        return false;
+    }
+
+    image.format = static_cast<EBlockFormat>(format - std::begin(FORMAT_FOURCC));
+    image.width = static_cast<int>(header.width);
+    image.height = static_cast<int>(header.height);
+    image.levels.clear();
+    // never more levels than the full chain, floor(log2(max(width, height))) + 1
+    uint32_t chainLength = 1;
+    for (uint32_t size = std::max(header.width, header.height); size > 1; size /= 2)
+        chainLength++;
+    const uint32_t levelCount = std::min(std::max(header.mipMapCount, 1u), chainLength);
+    int levelWidth = image.width, levelHeight = image.height;
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        std::vector<unsigned char> blocks(LevelSize(image.format, levelWidth, levelHeight));
+        file.read(reinterpret_cast<char*>(blocks.data()), blocks.size());
+        if (!file)
+            return false;
+        image.levels.push_back(std::move(blocks));
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+    return true;
+}
+
+unsigned int TextureCompressor::Upload(const CompressedImage& image, bool gamma)
+{
+    if (image.levels.empty() || !IsSupported(image.format))
+        return 0;
+
+    const GLenum internalFormat = GetInternalFormat(image.format, gamma);
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    int levelWidth = image.width, levelHeight = image.height;
+    for (size_t level = 0; level < image.levels.size(); level++)
+    {
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, levelWidth, levelHeight, 0,
+            static_cast<GLsizei>(image.levels[level].size()), image.levels[level].data());
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+    ApplySwizzle(GL_TEXTURE_2D, internalFormat);
+    // the mip chain came from the file
+    TextureLoader::SetupSampling(GL_TEXTURE_2D, false);
+    return textureID;
+}
+
+bool TextureCompressor::IsSupported(EBlockFormat format)
+{
+    const bool s3tc = format == EBlockFormat::BC1 || format == EBlockFormat::BC3;
+    return !s3tc || GLExtensions::Instance().textureCompressionS3TC;
+}
+
+unsigned int TextureCompressor::GetInternalFormat(EBlockFormat format, bool gamma)
+{
+    switch (format)
+    {
+    case EBlockFormat::BC1: return gamma ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case EBlockFormat::BC3: return gamma ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case EBlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+    default:                return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+void TextureCompressor::ApplySwizzle(unsigned int target, int internalFormat)
+{
+    if (internalFormat == GL_COMPRESSED_RED_RGTC1)
+    {
+        glTexParameteri(target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+    else if (internalFormat == GL_COMPRESSED_RG_RGTC2)
+    {
+        glTexParameteri(target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        glTexParameteri(target, GL_TEXTURE_SWIZZLE_A, GL_GREEN);
+    }
+}
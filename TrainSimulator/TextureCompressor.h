@@ -0,0 +1,60 @@
+#pragma once
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <string>
+#include <vector>
+
+// block compressed formats the encoder produces, picked from the channels of the source image
+enum class EBlockFormat {
+    BC1, // RGB, opaque color maps (8 bytes per 4x4 block)
+    BC3, // RGBA, color maps with alpha (16 bytes per block)
+    BC4, // one channel, grayscale maps, sampled as luminance (8 bytes per block)
+    BC5  // two channels, grayscale + alpha maps, sampled as luminance-alpha (16 bytes per block)
+};
+
+// a block compressed image with its whole mip chain, level 0 first
+struct CompressedImage {
+    EBlockFormat format = EBlockFormat::BC1;
+    int width = 0;
+    int height = 0;
+    std::vector<std::vector<unsigned char>> levels;
+};
+
+// Offline block compression of textures.
+// Compress encodes an image file and its mip chain on the CPU (stb_dxt) into "<image>.dds" next to it, the loaders
+// then upload that file with glCompressedTexImage2D instead of decoding the source into uncompressed RGBA.
+// A DDS older than its source is stale and ignored.
+class TextureCompressor
+{
+public:
+    // path of the compressed copy of an image
+    static std::string GetCompressedPath(const std::string& imagePath);
+
+    // true when imagePath has a compressed copy at least as new as the image
+    static bool HasCompressed(const std::string& imagePath);
+
+    // encodes imagePath into GetCompressedPath(imagePath), returns false if the image can't be read or the file written
+    static bool Compress(const std::string& imagePath);
+
+    // compresses every image below directory that has no up to date copy, returns the number of files written
+    static unsigned int CompressDirectory(const std::string& directory);
+
+    // reads a DDS written by Compress
+    static bool Load(const std::string& ddsPath, CompressedImage& image);
+
+    // creates a GL texture from a compressed image, 0 when the GPU can't sample its format (S3TC is an extension)
+    static unsigned int Upload(const CompressedImage& image, bool gamma);
+
+    // false when the GPU can't sample format
+    static bool IsSupported(EBlockFormat format);
+
+    // GL internal format of a block format, the sRGB variant when gamma is set and the format has one
+    static unsigned int GetInternalFormat(EBlockFormat format, bool gamma);
+
+    // points the green/blue (and alpha) channels of a BC4/BC5 texture at its luminance/alpha,
+    // for the texture bound to target with the given internal format. other formats are left alone
+    static void ApplySwizzle(unsigned int target, int internalFormat);
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "TextureLoader.h"
+
+#include "GLExtensions.h"
+#include "TextureCompressor.h"
+#include "Utils.h"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // an image decoded by a worker, waiting to be uploaded
+    struct DecodedImage {
+        size_t index;
+        unsigned char* pixels;
+        int width;
+        int height;
+        double decodeMs;
+        bool compressed;             // read from the block compressed copy, pixels is unused
+        CompressedImage blocks;
+    };
+}
+
+float TextureLoader::maxAnisotropy = 8.0f;
+
+TextureLoader::TextureLoader(unsigned int workerCount) : workerCount(workerCount)
+{
+    if (this->workerCount == 0)
+        this->workerCount = std::max(1u, std::thread::hardware_concurrency());
+}
+
+size_t TextureLoader::Add(const std::string& path, bool gamma)
+{
+    requests.push_back({ path, gamma });
+    return requests.size() - 1;
+}
+
+std::vector<unsigned int> TextureLoader::LoadAll()
+{
+    std::vector<unsigned int> ids(requests.size(), 0);
+    if (requests.empty())
+        return ids;
+
+    const Clock::time_point batchStart = Clock::now();
+
+    std::atomic<size_t> nextRequest(0);
+    std::mutex readyMutex;
+    std::condition_variable readyCondition;
+    std::deque<DecodedImage> ready;
+
+    // workers pull the next file to decode and hand the pixels over to the GL thread
+    auto decode = [&]() {
+        for (size_t index = nextRequest++; index < requests.size(); index = nextRequest++)
+        {
+            const Clock::time_point start = Clock::now();
+            DecodedImage image = { index, nullptr, 0, 0, 0.0, false, CompressedImage() };
+            const std::string& path = requests[index].path;
+            image.compressed = TextureCompressor::HasCompressed(path) && TextureCompressor::Load(TextureCompressor::GetCompressedPath(path), image.blocks);
+            if (!image.compressed)
+            {
+                int channels;
+                image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+            }
+            image.decodeMs = MillisecondsSince(start);
+            {
+                std::lock_guard<std::mutex> lock(readyMutex);
+                ready.push_back(std::move(image));
+            }
+            readyCondition.notify_one();
+        }
+    };
+
+    const unsigned int threadCount = static_cast<unsigned int>(std::min<size_t>(workerCount, requests.size()));
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(decode);
+
+    // upload on this thread as soon as images are decoded
+    double totalDecodeMs = 0.0;
+    double totalUploadMs = 0.0;
+    for (size_t uploaded = 0; uploaded < requests.size(); uploaded++)
+    {
+        DecodedImage image;
+        {
+            std::unique_lock<std::mutex> lock(readyMutex);
+            readyCondition.wait(lock, [&ready]() { return !ready.empty(); });
+            image = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        const std::string& path = requests[image.index].path;
+        totalDecodeMs += image.decodeMs;
+        if (image.compressed)
+        {
+            const Clock::time_point start = Clock::now();
+            ids[image.index] = TextureCompressor::Upload(image.blocks, requests[image.index].gamma);
+            const double uploadMs = MillisecondsSince(start);
+            totalUploadMs += uploadMs;
+            if (ids[image.index] != 0)
+            {
+                std::cout << "Loaded compressed texture: " << path << " (read " << image.decodeMs << " ms, upload " << uploadMs << " ms)" << std::endl;
+                continue;
+            }
+            // the GPU can't sample the format, decode the source after all
+            int channels;
+            image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+        }
+        if (!image.pixels)
+        {
+            std::cerr << "Failed to load texture: " << path << std::endl;
+            continue;
+        }
+
+        const Clock::time_point start = Clock::now();
+        ids[image.index] = Upload(image.pixels, image.width, image.height, requests[image.index].gamma);
+        const double uploadMs = MillisecondsSince(start);
+        totalUploadMs += uploadMs;
+        stbi_image_free(image.pixels);
+
+        std::cout << "Loaded texture: " << path << " (decode " << image.decodeMs << " ms, upload " << uploadMs << " ms)" << std::endl;
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    std::cout << "Loaded " << requests.size() << " textures on " << threadCount << " workers in " << MillisecondsSince(batchStart)
+        << " ms (decode " << totalDecodeMs << " ms, upload " << totalUploadMs << " ms)" << std::endl;
+
+    requests.clear();
+    return ids;
+}
+
+unsigned int TextureLoader::Upload(const unsigned char* pixels, int width, int height, bool gamma)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, gamma ? GL_SRGB_ALPHA : GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    SetupSampling(GL_TEXTURE_2D);
+
+    return textureID;
+}
+
+void TextureLoader::SetMaxAnisotropy(float anisotropy)
+{
+    maxAnisotropy = std::max(anisotropy, 1.0f);
+}
+
+void TextureLoader::SetupSampling(unsigned int target, bool generateMipmaps)
+{
+    // distant surfaces read from small mips instead of sampling the full image sparsely
+    if (generateMipmaps)
+        glGenerateMipmap(target);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // anisotropy keeps ground seen at grazing angles sharp without falling back to the full resolution mip
+    const float supported = GLExtensions::Instance().maxAnisotropy;
+    if (supported >= 1.0f)
+        glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY, std::min(maxAnisotropy, supported));
+}
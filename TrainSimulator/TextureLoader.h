@@ -0,0 +1,47 @@
+#pragma once
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <vector>
+
+// Loads a batch of image files into GL textures.
+// Decoding (stbi_load) runs on a pool of worker threads, while the thread that calls LoadAll (the one owning
+// the GL context) only uploads the decoded images with glTexImage2D as soon as they become available.
+// An image with an up to date block compressed copy (TextureCompressor) is read from that instead and uploaded as is.
+class TextureLoader
+{
+public:
+    // workerCount = 0 uses one worker per hardware thread
+    explicit TextureLoader(unsigned int workerCount = 0);
+
+    // queues a file for loading and returns its position in the batch
+    size_t Add(const std::string& path, bool gamma = false);
+
+    // decodes and uploads every queued file, returns the texture ids in the order they were added (0 for failures).
+    // must be called from the thread owning the GL context.
+    std::vector<unsigned int> LoadAll();
+
+    // creates a GL texture from RGBA8 pixels, with a full mip chain
+    static unsigned int Upload(const unsigned char* pixels, int width, int height, bool gamma);
+
+    // anisotropic filtering level every texture set up by SetupSampling gets, clamped to what the GPU supports (1 turns it off)
+    static void SetMaxAnisotropy(float anisotropy);
+
+    // builds the mip chain of the texture bound to target (GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY) from its level 0 and
+    // sets up repeating, trilinear and anisotropic sampling. textures uploaded with their mips skip the generation
+    static void SetupSampling(unsigned int target, bool generateMipmaps = true);
+
+private:
+    struct Request {
+        std::string path;
+        bool gamma;
+    };
+
+    static float maxAnisotropy;
+
+    unsigned int workerCount;
+    std::vector<Request> requests;
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include "TextureManager.h"
+
+#include "GLExtensions.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <tuple>
+
+namespace
+{
+    // textures are never shrunk below this size, far away surfaces still get a few texels per face
+    const int MIN_RESIDENT_SIZE = 64;
+    // frames without a draw after which a texture counts as unused and can drop to its smallest size
+    const uint64_t UNUSED_FRAMES = 300;
+
+    // resident levels of the bound GL_TEXTURE_2D
+    GLint GetLevelCount()
+    {
+        GLint width = 0, height = 0, maxLevel = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        GLint levels = 1;
+        for (GLint size = std::max(width, height); size > 1 && levels <= maxLevel; size /= 2)
+            levels++;
+        return levels;
+    }
+
+    // video memory of every resident level of the bound GL_TEXTURE_2D, uncompressed textures are RGBA8
+    size_t QueryResidentBytes()
+    {
+        GLint compressed = GL_FALSE;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        const GLint levelCount = GetLevelCount();
+        size_t bytes = 0;
+        for (GLint level = 0; level < levelCount; level++)
+        {
+            GLint width = 0, height = 0, size = 0;
+            if (compressed)
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            else
+            {
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+                size = width * height * 4;
+            }
+            bytes += static_cast<size_t>(size);
+        }
+        return bytes;
+    }
+
+    // how many times size can be halved before it goes below target
+    int HalvingsAbove(int size, float target)
+    {
+        int halvings = 0;
+        while (static_cast<float>(size >> (halvings + 1)) >= target && (size >> (halvings + 1)) > 0)
+            halvings++;
+        return halvings;
+    }
+}
+
+TextureManager::TextureManager(size_t budgetBytes, TextureStreamer& streamer) :
+    budgetBytes(budgetBytes), streamer(streamer), residentBytes(0), frame(0), pixelsPerUnit(1.0f)
+{
+}
+
+void TextureManager::Track(const Model& model)
+{
+    for (const Texture& texture : model.textures_loaded)
+    {
+        if (texture.id == 0 || indices.count(texture.id))
+            continue;
+
+        GLint width = 0, height = 0, internalFormat = 0;
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+
+        Residency residency;
+        residency.id = texture.id;
+        residency.path = texture.path;
+        // a reload has to come back in the same color space
+        residency.gamma = internalFormat == GL_SRGB8_ALPHA8 || internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ||
+            internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+        residency.fullSize = std::max(width, height);
+        residency.droppedLevels = 0;
+        residency.bytes = QueryResidentBytes();
+        residency.lastUsedFrame = frame;
+        residency.screenSize = 0.0f;
+        residency.reloading = false;
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        residentBytes += residency.bytes;
+        indices[texture.id] = textures.size();
+        textures.push_back(residency);
+    }
+}
+
+void TextureManager::BeginFrame(float pixelsPerUnit)
+{
+    frame++;
+    this->pixelsPerUnit = pixelsPerUnit;
+}
+
+void TextureManager::MarkUsed(const std::vector<Texture>& used, const AABB& worldBounds, const glm::vec3& viewPos)
+{
+    // the bounding sphere seen from the camera, a camera inside it gets the size at a distance of its radius
+    const float radius = worldBounds.GetRadius();
+    const float distance = std::max(glm::distance(viewPos, worldBounds.GetCenter()), std::max(radius, 1e-3f));
+    const float screenSize = 2.0f * radius / distance * pixelsPerUnit;
+
+    for (const Texture& texture : used)
+    {
+        auto it = indices.find(texture.id);
+        if (it == indices.end())
+            continue;
+        Residency& residency = textures[it->second];
+        if (residency.lastUsedFrame != frame)
+        {
+            residency.lastUsedFrame = frame;
+            residency.screenSize = screenSize;
+        }
+        else
+            residency.screenSize = std::max(residency.screenSize, screenSize);
+    }
+}
+
+void TextureManager::Update()
+{
+    // reloads land whenever the streamer gets to them
+    bool reloading = false;
+    for (Residency& texture : textures)
+    {
+        if (!texture.reloading)
+            continue;
+        refresh(texture);
+        texture.reloading = texture.droppedLevels > 0 && !streamer.IsIdle();
+        reloading = reloading || texture.reloading;
+    }
+
+    if (residentBytes > budgetBytes)
+    {
+        // over budget: shrink the texture that needs its resolution least. textures that can go without a level come first,
+        // then the ones unused for longest, then the smallest on screen compared to their resident size
+        Residency* victim = nullptr;
+        std::tuple<bool, uint64_t, float> victimKey;
+        for (Residency& texture : textures)
+        {
+            if (texture.reloading || texture.droppedLevels >= HalvingsAbove(texture.fullSize, MIN_RESIDENT_SIZE))
+                continue;
+            const float residentSize = static_cast<float>(texture.fullSize >> texture.droppedLevels);
+            const std::tuple<bool, uint64_t, float> key(getWantedDrop(texture) > texture.droppedLevels, frame - texture.lastUsedFrame,
+                residentSize / std::max(texture.screenSize, 1.0f));
+            if (!victim || key > victimKey)
+            {
+                victim = &texture;
+                victimKey = key;
+            }
+        }
+        if (victim && !dropTopLevel(*victim))
+            std::cout << "WARNING::TEXTURE_MANAGER:: can't shrink " << victim->path << std::endl;
+        return;
+    }
+
+    // under budget: bring back the full image of the visible texture drawn largest compared to its resident size,
+    // one reload at a time and only if the budget still holds afterwards
+    if (reloading)
+        return;
+    Residency* restore = nullptr;
+    for (Residency& texture : textures)
+    {
+        if (texture.droppedLevels == 0 || texture.lastUsedFrame != frame || getWantedDrop(texture) >= texture.droppedLevels)
+            continue;
+        // every dropped level is a quarter of the size of the one above it
+        const size_t fullBytes = texture.bytes << (2 * texture.droppedLevels);
+        if (residentBytes - texture.bytes + fullBytes > budgetBytes)
+            continue;
+        if (!restore || texture.screenSize > restore->screenSize)
+            restore = &texture;
+    }
+    if (restore)
+    {
+        streamer.Reload(restore->id, restore->path, restore->gamma);
+        restore->reloading = true;
+    }
+}
+
+size_t TextureManager::GetDowngradedCount() const
+{
+    return static_cast<size_t>(std::count_if(textures.begin(), textures.end(), [](const Residency& texture) { return texture.droppedLevels > 0; }));
+}
+
+int TextureManager::getWantedDrop(const Residency& texture) const
+{
+    const int maxDrop = HalvingsAbove(texture.fullSize, MIN_RESIDENT_SIZE);
+    if (frame - texture.lastUsedFrame > UNUSED_FRAMES)
+        return maxDrop;
+    return std::min(HalvingsAbove(texture.fullSize, std::max(texture.screenSize, 1.0f)), maxDrop);
+}
+
+bool TextureManager::dropTopLevel(Residency& texture)
+{
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    GLint compressed = GL_FALSE, internalFormat = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    const GLint levelCount = GetLevelCount();
+    if (levelCount < 2)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return false;
+    }
+
+    // read back every level below the top one
+    struct Level {
+        GLint width;
+        GLint height;
+        std::vector<unsigned char> data;
+    };
+    std::vector<Level> levels(levelCount - 1);
+    for (GLint level = 1; level < levelCount; level++)
+    {
+        Level& copy = levels[level - 1];
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &copy.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &copy.height);
+        if (compressed)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            copy.data.resize(size);
+            glGetCompressedTexImage(GL_TEXTURE_2D, level, copy.data.data());
+        }
+        else
+        {
+            copy.data.resize(static_cast<size_t>(copy.width) * copy.height * 4);
+            glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, copy.data.data());
+        }
+    }
+
+    // and move them one level up, the old top level is released when level 0 is re-specified smaller
+    for (size_t level = 0; level < levels.size(); level++)
+    {
+        const Level& copy = levels[level];
+        if (compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, copy.width, copy.height, 0,
+                static_cast<GLsizei>(copy.data.size()), copy.data.data());
+        else
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, copy.width, copy.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, copy.data.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size()) - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    texture.droppedLevels++;
+    refresh(texture);
+    return true;
+}
+
+void TextureManager::refresh(Residency& texture)
+{
+    GLint width = 0, height = 0;
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    const size_t bytes = QueryResidentBytes();
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    texture.droppedLevels = HalvingsAbove(texture.fullSize, static_cast<float>(std::max(std::max(width, height), 1)));
+    residentBytes = residentBytes - texture.bytes + bytes;
+    texture.bytes = bytes;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glm.hpp>
+
+#include "Bounds.h"
+#include "Model.h"
+#include "TextureStreamer.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Keeps the model textures under a video memory budget.
+// Every tracked texture knows its resident size, the last frame it was drawn and how large it was on screen then
+// (reported by RenderScene through MarkUsed). While over budget, Update drops the top mip of the texture that needs
+// its resolution least (unused for longest, then smallest on screen compared to its size), one texture per frame since
+// the remaining levels are read back and re-specified. When a visible texture is drawn larger than its resident
+// resolution and the budget allows, its full image is streamed back in through the TextureStreamer.
+// Texture names never change, so materials keep pointing at the same textures.
+class TextureManager
+{
+public:
+    TextureManager(size_t budgetBytes, TextureStreamer& streamer);
+
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    // starts managing every texture of model, textures already tracked (shared with another model) are skipped.
+    // textures must be fully loaded
+    void Track(const Model& model);
+
+    // starts a frame, pixelsPerUnit is the on-screen size in pixels of one world unit seen from a distance of one unit
+    void BeginFrame(float pixelsPerUnit);
+
+    // records that textures are drawn this frame by geometry covering worldBounds
+    void MarkUsed(const std::vector<Texture>& used, const AABB& worldBounds, const glm::vec3& viewPos);
+
+    // downgrades or restores at most one texture, call after the frame marked its textures
+    void Update();
+
+    size_t GetBudgetBytes() const { return budgetBytes; }
+    size_t GetResidentBytes() const { return residentBytes; }
+    size_t GetTextureCount() const { return textures.size(); }
+    // textures currently without their top mips
+    size_t GetDowngradedCount() const;
+
+private:
+    struct Residency {
+        unsigned int id;
+        std::string path;
+        bool gamma;
+        int fullSize;           // largest dimension of the full resolution image
+        int droppedLevels;      // top mips not resident
+        size_t bytes;           // resident size of every level
+        uint64_t lastUsedFrame;
+        float screenSize;       // largest on-screen size in pixels of the geometry using it in lastUsedFrame
+        bool reloading;         // the full image is on its way through the streamer
+    };
+
+    // top mips the texture can drop without looking worse at its last on-screen size, all of them when unused for long
+    int getWantedDrop(const Residency& texture) const;
+    // drops the top mip of texture, false when it is already as small as allowed or can't be read back
+    bool dropTopLevel(Residency& texture);
+    // updates the resident size of texture from the GL, after a reload finished
+    void refresh(Residency& texture);
+
+    size_t budgetBytes;
+    TextureStreamer& streamer;
+    std::vector<Residency> textures;
+    std::unordered_map<unsigned int, size_t> indices; // texture name -> position in textures
+    size_t residentBytes;
+    uint64_t frame;
+    float pixelsPerUnit;
+};
+
+#endif
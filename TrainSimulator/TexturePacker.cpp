@@ -0,0 +1,195 @@
+#include "TexturePacker.h"
+
+#include "TextureCompressor.h"
+#include "TextureLoader.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+    // what decides which array a texture can go to
+    struct TextureFormat {
+        GLint width;
+        GLint height;
+        GLint internalFormat;
+        GLint compressed;
+
+        bool operator<(const TextureFormat& other) const
+        {
+            return std::tie(width, height, internalFormat) < std::tie(other.width, other.height, other.internalFormat);
+        }
+    };
+
+    TextureFormat QueryFormat(unsigned int texture)
+    {
+        TextureFormat format = { 0, 0, 0, GL_FALSE };
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &format.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &format.height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format.internalFormat);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &format.compressed);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return format;
+    }
+
+    // block compressed textures can't be render targets, so their layers are filled by reading back every level
+    // of the source and uploading it as is. returns false if a level is missing
+    bool CopyCompressed(const std::vector<unsigned int>& textures, const TextureFormat& format, unsigned int array,
+        std::unordered_map<unsigned int, TextureLayer>& layers)
+    {
+        const GLsizei layerCount = static_cast<GLsizei>(textures.size());
+        GLint levelCount = 1;
+        glBindTexture(GL_TEXTURE_2D, textures[0]);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &levelCount);
+        levelCount++;
+
+        std::vector<unsigned char> level;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        for (GLint mip = 0, width = format.width, height = format.height; mip < levelCount; mip++, width = std::max(width / 2, 1), height = std::max(height / 2, 1))
+        {
+            GLint levelSize = 0;
+            glBindTexture(GL_TEXTURE_2D, textures[0]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, mip, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelSize);
+            if (levelSize <= 0)
+                return false;
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, mip, format.internalFormat, width, height, layerCount, 0, levelSize * layerCount, nullptr);
+
+            level.resize(levelSize);
+            for (GLsizei layer = 0; layer < layerCount; layer++)
+            {
+                glBindTexture(GL_TEXTURE_2D, textures[layer]);
+                glGetCompressedTexImage(GL_TEXTURE_2D, mip, level.data());
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, mip, 0, 0, layer, width, height, 1, format.internalFormat, levelSize, level.data());
+            }
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        TextureCompressor::ApplySwizzle(GL_TEXTURE_2D_ARRAY, format.internalFormat);
+        TextureLoader::SetupSampling(GL_TEXTURE_2D_ARRAY, false);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        for (GLsizei layer = 0; layer < layerCount; layer++)
+            layers[textures[layer]] = { array, layer };
+        return true;
+    }
+}
+
+TexturePacker::~TexturePacker()
+{
+    if (!arrays.empty())
+        glDeleteTextures(static_cast<GLsizei>(arrays.size()), arrays.data());
+}
+
+void TexturePacker::Add(Mesh& mesh)
+{
+    meshes.push_back(&mesh);
+}
+
+void TexturePacker::Pack()
+{
+    // a white texel for submeshes that sample nothing, so every submesh has a layer
+    const unsigned char white[4] = { 255, 255, 255, 255 };
+    unsigned int whiteTexture;
+    glGenTextures(1, &whiteTexture);
+    glBindTexture(GL_TEXTURE_2D, whiteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+    // group the distinct textures by size and format, keeping the order they were found in
+    std::map<TextureFormat, std::vector<unsigned int>> groups;
+    std::unordered_map<unsigned int, TextureFormat> formats;
+    auto addTexture = [&](unsigned int texture) {
+        if (formats.count(texture))
+            return;
+        const TextureFormat format = QueryFormat(texture);
+        formats[texture] = format;
+        groups[format].push_back(texture);
+    };
+    addTexture(whiteTexture);
+    for (Mesh* mesh : meshes)
+        for (const SubMesh& subMesh : mesh->subMeshes)
+            if (!subMesh.textures.empty())
+                addTexture(subMesh.textures[0].id);
+
+    GLint maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    // copy every texture into its layer with a framebuffer blit, the images never come back to the CPU
+    unsigned int framebuffers[2];
+    glGenFramebuffers(2, framebuffers);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+    std::unordered_map<unsigned int, TextureLayer> layers;
+    for (const auto& group : groups)
+    {
+        const TextureFormat& format = group.first;
+        const std::vector<unsigned int>& textures = group.second;
+        for (size_t first = 0; first < textures.size(); first += maxLayers)
+        {
+            const GLsizei layerCount = static_cast<GLsizei>(std::min<size_t>(maxLayers, textures.size() - first));
+            unsigned int array;
+            glGenTextures(1, &array);
+            if (format.compressed)
+            {
+                const std::vector<unsigned int> run(textures.begin() + first, textures.begin() + first + layerCount);
+                if (CopyCompressed(run, format, array, layers))
+                    arrays.push_back(array);
+                else
+                {
+                    // the submeshes keep the white layer
+                    std::cout << "ERROR::TEXTURE_PACKER:: compressed textures of " << format.width << "x" << format.height << " can't be read back" << std::endl;
+                    glDeleteTextures(1, &array);
+                }
+                continue;
+            }
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format.internalFormat, format.width, format.height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            arrays.push_back(array);
+
+            for (GLsizei layer = 0; layer < layerCount; layer++)
+            {
+                const unsigned int texture = textures[first + layer];
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+                glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array, 0, layer);
+                if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE ||
+                    glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                {
+                    std::cout << "ERROR::TEXTURE_PACKER:: texture " << texture << " can't be copied into an array" << std::endl;
+                    continue;
+                }
+                glBlitFramebuffer(0, 0, format.width, format.height, 0, 0, format.width, format.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                layers[texture] = { array, layer };
+            }
+
+            // only level 0 is copied, the array builds its own mip chain
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            TextureLoader::SetupSampling(GL_TEXTURE_2D_ARRAY);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(2, framebuffers);
+    glDeleteTextures(1, &whiteTexture);
+
+    const TextureLayer whiteLayer = layers[whiteTexture];
+    for (Mesh* mesh : meshes)
+    {
+        for (SubMesh& subMesh : mesh->subMeshes)
+        {
+            auto it = subMesh.textures.empty() ? layers.end() : layers.find(subMesh.textures[0].id);
+            subMesh.diffuseLayer = it != layers.end() ? it->second : whiteLayer;
+        }
+    }
+
+    std::cout << "Packed " << formats.size() << " textures into " << arrays.size() << " texture arrays" << std::endl;
+    meshes.clear();
+}
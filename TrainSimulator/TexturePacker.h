@@ -0,0 +1,34 @@
+#pragma once
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+
+#include "Mesh.h"
+
+#include <vector>
+
+// Copies the 2D textures of a set of meshes into GL_TEXTURE_2D_ARRAYs, one array per size and format.
+// Afterwards every submesh names its texture by array and layer (SubMesh::diffuseLayer), so draws of submeshes
+// with different textures but the same array no longer need a texture bind in between.
+class TexturePacker
+{
+public:
+    TexturePacker() = default;
+    ~TexturePacker();
+
+    TexturePacker(const TexturePacker&) = delete;
+    TexturePacker& operator=(const TexturePacker&) = delete;
+
+    // queues the texture every submesh of mesh samples (its first texture, bound to unit 0)
+    void Add(Mesh& mesh);
+
+    // builds the arrays on the GPU and assigns the layers. submeshes without a texture get a white layer
+    void Pack();
+
+    size_t GetArrayCount() const { return arrays.size(); }
+
+private:
+    std::vector<Mesh*> meshes;
+    std::vector<unsigned int> arrays; // owned
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "TextureRegistry.h"
+
+#include <glad/glad.h>
+
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+TextureHandle::TextureHandle(Entry* entry) : entry(entry)
+{
+    if (entry)
+        entry->refCount++;
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other) : TextureHandle(other.entry)
+{
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other) noexcept : entry(other.entry)
+{
+    other.entry = nullptr;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle other) noexcept
+{
+    std::swap(entry, other.entry);
+    return *this;
+}
+
+TextureHandle::~TextureHandle()
+{
+    if (entry)
+        TextureRegistry::Instance().Release(entry);
+}
+
+unsigned int TextureHandle::GetID() const
+{
+    return entry ? entry->id : 0;
+}
+
+const std::string& TextureHandle::GetPath() const
+{
+    static const std::string empty;
+    return entry ? entry->path : empty;
+}
+
+TextureRegistry& TextureRegistry::Instance()
+{
+    static TextureRegistry registry;
+    return registry;
+}
+
+std::string TextureRegistry::Canonicalize(const std::string& path)
+{
+    std::error_code error;
+    fs::path canonical = fs::weakly_canonical(fs::path(path), error);
+    if (error)
+        canonical = fs::absolute(fs::path(path), error).lexically_normal();
+    return canonical.generic_string();
+}
+
+TextureHandle TextureRegistry::Find(const std::string& canonicalPath)
+{
+    auto it = entries.find(canonicalPath);
+    if (it == entries.end())
+        return TextureHandle();
+    return TextureHandle(&it->second);
+}
+
+TextureHandle TextureRegistry::Insert(const std::string& canonicalPath, unsigned int id)
+{
+    auto result = entries.emplace(canonicalPath, TextureHandle::Entry{ canonicalPath, id, 0 });
+    if (!result.second)
+    {
+        // already registered, keep the first texture and drop the duplicate
+        std::cout << "WARNING::TEXTURE_REGISTRY:: texture uploaded twice: " << canonicalPath << std::endl;
+        glDeleteTextures(1, &id);
+    }
+    return TextureHandle(&result.first->second);
+}
+
+size_t TextureRegistry::GetTextureCount() const
+{
+    return entries.size();
+}
+
+void TextureRegistry::Release(TextureHandle::Entry* entry)
+{
+    if (--entry->refCount > 0)
+        return;
+    // erase by iterator, entry->path lives in the node being erased
+    auto it = entries.find(entry->path);
+    glDeleteTextures(1, &it->second.id);
+    entries.erase(it);
+}
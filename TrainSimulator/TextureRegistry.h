@@ -0,0 +1,75 @@
+#pragma once
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <string>
+#include <unordered_map>
+
+class TextureRegistry;
+
+// Reference to a GL texture owned by the TextureRegistry.
+// Copies share the texture; the GL texture is deleted when the last handle goes away.
+class TextureHandle
+{
+public:
+    TextureHandle() = default;
+    TextureHandle(const TextureHandle& other);
+    TextureHandle(TextureHandle&& other) noexcept;
+    TextureHandle& operator=(TextureHandle other) noexcept;
+    ~TextureHandle();
+
+    // GL texture name, 0 for an empty handle
+    unsigned int GetID() const;
+
+    // canonical path the texture was loaded from
+    const std::string& GetPath() const;
+
+    explicit operator bool() const { return entry != nullptr; }
+
+private:
+    friend class TextureRegistry;
+
+    struct Entry {
+        std::string path;
+        unsigned int id;
+        unsigned int refCount;
+    };
+
+    explicit TextureHandle(Entry* entry);
+
+    Entry* entry = nullptr;
+};
+
+// Process-wide table of the textures loaded from disk, indexed by canonical path, so an image used by several
+// models is decoded and uploaded exactly once. Only used from the thread owning the GL context.
+class TextureRegistry
+{
+public:
+    static TextureRegistry& Instance();
+
+    // absolute, normalized form of path used as the registry key
+    static std::string Canonicalize(const std::string& path);
+
+    // returns the texture loaded from canonicalPath, or an empty handle if it isn't loaded
+    TextureHandle Find(const std::string& canonicalPath);
+
+    // takes ownership of the GL texture id loaded from canonicalPath
+    TextureHandle Insert(const std::string& canonicalPath, unsigned int id);
+
+    // number of textures currently alive
+    size_t GetTextureCount() const;
+
+private:
+    friend class TextureHandle;
+
+    TextureRegistry() = default;
+    TextureRegistry(const TextureRegistry&) = delete;
+    TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+    void Release(TextureHandle::Entry* entry);
+
+    // node based, so entry pointers held by handles stay valid while the table grows
+    std::unordered_map<std::string, TextureHandle::Entry> entries;
+};
+
+#endif
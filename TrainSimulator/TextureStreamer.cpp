@@ -0,0 +1,287 @@
+#include "TextureStreamer.h"
+
+#include "GLExtensions.h"
+#include "TextureLoader.h"
+#include "Utils.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+    const unsigned int SLICE_COUNT = 3;
+    const size_t SLICE_ALIGNMENT = 16;
+
+    // mid gray, close to the average texture so the switch to the real image doesn't flash
+    const unsigned char PLACEHOLDER_TEXEL[4] = { 128, 128, 128, 255 };
+}
+
+size_t TextureStreamer::DecodedImage::GetSize() const
+{
+    if (compressed)
+    {
+        size_t size = 0;
+        for (const std::vector<unsigned char>& level : blocks.levels)
+            size += level.size();
+        return size;
+    }
+    return pixels ? static_cast<size_t>(width) * height * 4 : 0;
+}
+
+TextureStreamer::TextureStreamer(size_t budgetBytes, double budgetMs, unsigned int workerCount) :
+    sliceSize(AlignUp(std::max<size_t>(budgetBytes, SLICE_ALIGNMENT), SLICE_ALIGNMENT)), budgetMs(budgetMs),
+    persistent(GLExtensions::Instance().bufferStorage), mapped(nullptr), slice(0), fences(SLICE_COUNT, nullptr),
+    stopping(false), outstanding(0), uploaded(0)
+{
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    if (persistent)
+    {
+        // mapped once for the lifetime of the streamer, the fences alone keep the CPU off slices the GPU still reads
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLExtensions::Instance().BufferStorage(GL_PIXEL_UNPACK_BUFFER, sliceSize * SLICE_COUNT, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, sliceSize * SLICE_COUNT, flags));
+    }
+    else
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, sliceSize * SLICE_COUNT, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (workerCount == 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < workerCount; i++)
+        workers.emplace_back(&TextureStreamer::decode, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobCondition.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    for (DecodedImage& image : ready)
+        stbi_image_free(image.pixels);
+
+    for (GLsync fence : fences)
+        if (fence)
+            glDeleteSync(fence);
+    // deleting the buffer unmaps it
+    glDeleteBuffers(1, &buffer);
+}
+
+unsigned int TextureStreamer::Request(const std::string& path, bool gamma)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_TEXEL);
+    TextureLoader::SetupSampling(GL_TEXTURE_2D, false);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    Reload(texture, path, gamma);
+    return texture;
+}
+
+void TextureStreamer::Reload(unsigned int texture, const std::string& path, bool gamma)
+{
+    if (outstanding == 0)
+        firstRequest = std::chrono::steady_clock::now();
+    outstanding++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({ texture, path, gamma });
+    }
+    jobCondition.notify_one();
+}
+
+void TextureStreamer::Update()
+{
+    if (outstanding == 0)
+        return;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // take decoded images until the slice is full or the time is spent, an image that doesn't fit waits for the next frame
+    std::vector<std::pair<DecodedImage, size_t>> batch;
+    size_t used = 0;
+    bool sliceOpen = false;
+    while (MillisecondsSince(start) < budgetMs)
+    {
+        DecodedImage image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready.empty())
+                break;
+            const size_t size = ready.front().GetSize();
+            if (used > 0 && used + size > sliceSize)
+                break;
+            image = std::move(ready.front());
+            ready.pop_front();
+        }
+        outstanding--;
+
+        const size_t size = image.GetSize();
+        if (size == 0)
+        {
+            std::cerr << "Failed to load texture: " << image.job.path << std::endl;
+            continue;
+        }
+
+        // bigger than a whole slice: the only upload of this frame, straight from client memory
+        if (size > sliceSize)
+        {
+            specify(image, image.compressed ? nullptr : image.pixels);
+            stbi_image_free(image.pixels);
+            uploaded++;
+            break;
+        }
+
+        if (!sliceOpen)
+        {
+            if (!beginSlice())
+            {
+                std::cout << "ERROR::TEXTURE_STREAMER:: can't map the upload ring" << std::endl;
+                specify(image, image.compressed ? nullptr : image.pixels);
+                stbi_image_free(image.pixels);
+                uploaded++;
+                break;
+            }
+            sliceOpen = true;
+        }
+        unsigned char* sliceData = persistent ? mapped + slice * sliceSize : mapped;
+        copyImage(image, sliceData + used);
+        batch.emplace_back(std::move(image), slice * sliceSize + used);
+        used += AlignUp(size, SLICE_ALIGNMENT);
+    }
+
+    if (sliceOpen)
+    {
+        // the texture uploads read the buffer, a regular mapping has to end before they are issued
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        if (!persistent)
+        {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            mapped = nullptr;
+        }
+        for (std::pair<DecodedImage, size_t>& entry : batch)
+        {
+            specify(entry.first, reinterpret_cast<const unsigned char*>(entry.second));
+            stbi_image_free(entry.first.pixels);
+            uploaded++;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        fences[slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    if (outstanding == 0)
+        std::cout << "Streamed " << uploaded << " textures in " << MillisecondsSince(firstRequest) << " ms" << std::endl;
+}
+
+void TextureStreamer::decode()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        DecodedImage image;
+        image.job = std::move(job);
+        const std::string& path = image.job.path;
+        image.compressed = TextureCompressor::HasCompressed(path) && TextureCompressor::Load(TextureCompressor::GetCompressedPath(path), image.blocks) &&
+            TextureCompressor::IsSupported(image.blocks.format);
+        if (!image.compressed)
+        {
+            int channels;
+            image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(std::move(image));
+    }
+}
+
+bool TextureStreamer::beginSlice()
+{
+    slice = (slice + 1) % SLICE_COUNT;
+
+    // the slice was last read SLICE_COUNT frames ago, this normally returns immediately
+    if (fences[slice])
+    {
+        glClientWaitSync(fences[slice], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fences[slice]);
+        fences[slice] = nullptr;
+    }
+
+    if (persistent)
+        return mapped != nullptr;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, slice * sliceSize, sliceSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return mapped != nullptr;
+}
+
+void TextureStreamer::copyImage(const DecodedImage& image, unsigned char* dest)
+{
+    if (!image.compressed)
+    {
+        std::memcpy(dest, image.pixels, image.GetSize());
+        return;
+    }
+    for (const std::vector<unsigned char>& level : image.blocks.levels)
+    {
+        std::memcpy(dest, level.data(), level.size());
+        dest += level.size();
+    }
+}
+
+void TextureStreamer::specify(const DecodedImage& image, const unsigned char* source)
+{
+    // the owner may have released the texture before its image arrived
+    if (!glIsTexture(image.job.texture))
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, image.job.texture);
+    if (image.compressed)
+    {
+        // client memory uploads read every level from the blocks themselves
+        const GLenum internalFormat = TextureCompressor::GetInternalFormat(image.blocks.format, image.job.gamma);
+        int levelWidth = image.blocks.width, levelHeight = image.blocks.height;
+        size_t offset = 0;
+        for (size_t level = 0; level < image.blocks.levels.size(); level++)
+        {
+            const std::vector<unsigned char>& blocks = image.blocks.levels[level];
+            const void* data = source ? static_cast<const void*>(source + offset) : blocks.data();
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, levelWidth, levelHeight, 0,
+                static_cast<GLsizei>(blocks.size()), data);
+            offset += blocks.size();
+            levelWidth = std::max(levelWidth / 2, 1);
+            levelHeight = std::max(levelHeight / 2, 1);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.blocks.levels.size()) - 1);
+        TextureCompressor::ApplySwizzle(GL_TEXTURE_2D, internalFormat);
+        TextureLoader::SetupSampling(GL_TEXTURE_2D, false);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, image.job.gamma ? GL_SRGB_ALPHA : GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, source);
+        // a texture shortened by TextureManager gets its whole chain back
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        TextureLoader::SetupSampling(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include "TextureCompressor.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads textures in the background while the scene is already drawn.
+// Request hands out a texture name right away, holding a 1x1 placeholder texel. Workers decode the image (or read its
+// block compressed copy) and Update, called once per frame on the thread owning the GL context, copies decoded images
+// into a ring of pixel buffer objects and re-specifies the same texture from there. A frame uploads at most one slice
+// of the ring (the byte budget) and stops early once the time budget is spent, so streaming never stalls a frame for long.
+// The ring is persistently mapped when the context has buffer storage, mapped unsynchronized every frame otherwise.
+class TextureStreamer
+{
+public:
+    // budgetBytes: ring slice filled per frame, budgetMs: GL thread time per frame, workerCount = 0 uses one worker per hardware thread
+    TextureStreamer(size_t budgetBytes, double budgetMs, unsigned int workerCount = 0);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // creates the texture with its placeholder and queues the file, the returned name stays the same once the image arrives
+    unsigned int Request(const std::string& path, bool gamma = false);
+
+    // queues the file again for an existing texture, which keeps its current image until the full one arrives
+    void Reload(unsigned int texture, const std::string& path, bool gamma = false);
+
+    // uploads decoded images within the per-frame budget, must be called from the thread owning the GL context
+    void Update();
+
+    // true when every requested texture has been uploaded (or failed)
+    bool IsIdle() const { return outstanding == 0; }
+
+    size_t GetPendingCount() const { return outstanding; }
+    size_t GetUploadedCount() const { return uploaded; }
+
+private:
+    struct Job {
+        unsigned int texture;
+        std::string path;
+        bool gamma;
+    };
+
+    // an image decoded by a worker, waiting to be uploaded
+    struct DecodedImage {
+        Job job;
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        bool compressed = false;    // read from the block compressed copy, pixels is unused
+        CompressedImage blocks;
+
+        size_t GetSize() const;
+    };
+
+    // worker loop
+    void decode();
+    // starts writing the next slice once the GPU is done reading it
+    bool beginSlice();
+    // copies the pixels (or every level of the blocks) of image to dest
+    static void copyImage(const DecodedImage& image, unsigned char* dest);
+    // re-specifies the texture of image from source, an offset into the bound pixel unpack buffer or client memory
+    static void specify(const DecodedImage& image, const unsigned char* source);
+
+    size_t sliceSize;
+    double budgetMs;
+    bool persistent;
+    unsigned int buffer;
+    unsigned char* mapped;          // whole ring when persistent, the current slice otherwise
+    unsigned int slice;
+    std::vector<GLsync> fences;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobCondition;
+    std::deque<Job> jobs;
+    std::deque<DecodedImage> ready;
+    bool stopping;
+
+    size_t outstanding;
+    size_t uploaded;
+    std::chrono::steady_clock::time_point firstRequest;
+};
+
+#endif
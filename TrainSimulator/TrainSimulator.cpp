@@ -1,5 +1,6 @@
 ﻿// TrainSimulator.cpp : Defines the entry point for the console application.
 #include <filesystem>
+#include <memory>
 #include <vector>
 
 #include "Camera.h"
@@ -7,6 +8,20 @@
 #include "Model.h"
 #include "LightAction.h"
 #include "CameraType.h"
+#include "Consist.h"
+#include "CubemapCache.h"
+#include "GLExtensions.h"
+#include "GpuPassProfiler.h"
+#include "HiZBuffer.h"
+#include "IndirectRenderer.h"
+#include "RenderQueue.h"
+#include "RenderSettings.h"
+#include "ShadowCascades.h"
+#include "StatsOverlay.h"
+#include "TextureCompressor.h"
+#include "TextureManager.h"
+#include "TextureStreamer.h"
+#include "UniformBlocks.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -16,13 +31,27 @@
 namespace fs = std::filesystem;
 namespace irr = irrklang;
 
+// fixed objects of the scene, indices into the scene object list. each object gets its own PerObject block every frame
+enum ESceneObject {
+	SCENE_TRAIN,
+	SCENE_WAGONS, // every wagon of the consist, one instanced object
+	SCENE_TERRAIN,
+	SCENE_BUCURESTI,
+	SCENE_BRASOV,
+	SCENE_OBJECT_COUNT
+};
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
-unsigned int LoadCubemap(std::vector<std::string> faces);
-void RenderScene(Shader& shader, Model& driverWagon, Model& terrain, Model& brasov, Model& bucharest);
+glm::mat4 TrainTransform(const TrainPose& pose);
+void UpdateSceneTransforms(std::vector<SceneObject>& objects, Consist& consist, std::vector<TrainPose>& wagonPoses);
+void RenderScene(RenderQueue& queue, UniformRing& ring, const std::vector<SceneObject>& objects, const std::vector<size_t>& objectOffsets, const glm::vec3& viewPos, const std::vector<PassView>& passViews, const HiZBuffer* occlusion, CullingStats& stats,
+	TextureManager* textures);
+std::string FormatRenderStats(float frameTime, const RenderQueue& queue, const std::vector<PassView>& passViews, const CullingStats& stats, unsigned int staticShadowRebuilds,
+	const GpuPassProfiler& prepassProfiler, const GpuPassProfiler (&shadingProfilers)[2], const TextureManager* textures);
 glm::vec3 MoveTrain(glm::vec3& trainPosition, float& degreesX, float& degreesY, float& degreesZ);
 void Menu();
 void PlaySounds();
@@ -34,6 +63,9 @@ float speed = 1.0f;
 
 bool isDay = true;
 bool isMoving = false;
+bool showRenderStats = false;
+bool occlusionCulling = true;
+bool depthPrepass = false;
 
 // camera
 Camera camera(glm::vec3(800.0f, -100.0f, -935.0f));
@@ -54,6 +86,7 @@ CameraType cameraType = CameraType::FREE;
 // Original position and rotation of the train in 'bucuresti'
 glm::vec3 trainPosition(1373.0f, -231.5f, -1482.0f);
 glm::vec3 trainRotation(0.0f, 315.3f, 0.0f);
+constexpr float TRAIN_SCALE = 10.0f;
 
 glm::vec3 prevPosition(0.0f, 0.0f, 0.0f);
 glm::vec3 prevRotation(0.0f, 0.0f, 0.0f);
@@ -79,9 +112,19 @@ void updateRotationAngle()
 	}
 }
 
-int main()
+int main(int argc, char* argv[])
 {
 	Menu();
+	const RenderSettings settings = RenderSettings::FromCommandLine(argc, argv);
+	depthPrepass = settings.depthPrepass;
+
+	// offline step, no window needed
+	if (!settings.compressTextures.empty())
+	{
+		const unsigned int written = TextureCompressor::CompressDirectory(settings.compressTextures);
+		std::cout << "Compressed " << written << " textures below " << settings.compressTextures << std::endl;
+		return 0;
+	}
 
 	if (!soundEngine)
 	{
@@ -93,13 +136,23 @@ int main()
 	// ------------------------------
 	std::cout << "glfw: initialize and configure\n";
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	// glfw window creation
+	// glfw window creation, with a 4.3 context for the indirect path when the driver has one, 3.3 otherwise
 	// --------------------
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "TrainSimulator", nullptr, nullptr);
+	GLFWwindow* window = nullptr;
+	if (settings.indirectDraw)
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "TrainSimulator", nullptr, nullptr);
+	}
+	if (window == nullptr)
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "TrainSimulator", nullptr, nullptr);
+	}
 	if (window == nullptr)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -125,6 +178,8 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	GLExtensions::Instance().Load((GLADloadproc)glfwGetProcAddress);
+	TextureLoader::SetMaxAnisotropy(settings.textureAnisotropy);
 
 	// configure global opengl state
 	// -----------------------------
@@ -182,10 +237,17 @@ int main()
 
 	// build and compile shaders
 	// -------------------------
+	Shader::UseProgramCache = settings.shaderCache;
 	Shader skyboxShader("skybox.vs", "skybox.fs");
 
-	Shader shadowMappingShader("ShadowMapping.vs", "ShadowMapping.fs");
+	Shader shadowMappingShader("ShadowMapping.vs", "ShadowMapping.fs", { settings.GetShadowFilterDefine() });
+	Shader shadowMappingUniformScaleShader("ShadowMapping.vs", "ShadowMapping.fs", { "UNIFORM_SCALE", settings.GetShadowFilterDefine() });
+	Shader shadowMappingInstancedShader("ShadowMapping.vs", "ShadowMapping.fs", { "INSTANCED", settings.GetShadowFilterDefine() });
+	Shader shadowMappingIndirectShader("ShadowMapping.vs", "ShadowMapping.fs", { "INSTANCED", "TEXTURE_ARRAY", settings.GetShadowFilterDefine() });
 	Shader shadowMappingDepthShader("ShadowMappingDepth.vs", "ShadowMappingDepth.fs");
+	Shader shadowMappingDepthInstancedShader("ShadowMappingDepth.vs", "ShadowMappingDepth.fs", { "INSTANCED" });
+	Shader depthPrepassShader("ShadowMappingDepth.vs", "ShadowMappingDepth.fs", { "CAMERA_DEPTH" });
+	Shader depthPrepassInstancedShader("ShadowMappingDepth.vs", "ShadowMappingDepth.fs", { "CAMERA_DEPTH", "INSTANCED" });
 
 	// skybox VAO
 	unsigned int skyboxVAO, skyboxVBO;
@@ -202,42 +264,89 @@ int main()
 	fs::path localPath = fs::current_path();
 	std::string textureFolder = localPath.string() + "/Resources/textures";
 
-	Model driverWagon(localPath.string() + "/Resources/train/train.obj");
-	Model terrain(localPath.string() + "/Resources/terrain/terrain.obj");
+	// with streaming the models come up with placeholder textures and the real ones are uploaded a few per frame.
+	// the texture budget streams the full images of downgraded textures back in the same way
+	std::unique_ptr<TextureStreamer> textureStreamer;
+	if (settings.textureStreaming || settings.textureBudgetMB > 0.0f)
+		textureStreamer.reset(new TextureStreamer(static_cast<size_t>(settings.textureUploadMB * 1024.0f * 1024.0f), settings.textureUploadMs));
+	std::unique_ptr<TextureManager> textureManager;
+	if (settings.textureBudgetMB > 0.0f)
+		textureManager.reset(new TextureManager(static_cast<size_t>(settings.textureBudgetMB * 1024.0f * 1024.0f), *textureStreamer));
+	ModelOptions modelOptions;
+	modelOptions.textureStreamer = settings.textureStreaming ? textureStreamer.get() : nullptr;
+
+	// terrain and stations never move, their meshes are merged into material batches
+	ModelOptions staticModel = modelOptions;
+	staticModel.mergeMeshes = true;
+
+	Model driverWagon(localPath.string() + "/Resources/train/train.obj", false, modelOptions);
+	Model terrain(localPath.string() + "/Resources/terrain/terrain.obj", false, staticModel);
 	std::cout << "Loaded terrain\n";
 
-	Model bucuresti(localPath.string() + "/Resources/stations/bucurestiMap/bucuresti.obj");
-	Model brasov(localPath.string() + "/Resources/stations/brasovMap/brasov.obj");
-
-	// configure depth map FBO
-	// -----------------------
-	constexpr unsigned int SHADOW_WIDTH = 2048, SHADOW_HEIGHT = 2048;
-	unsigned int depthMapFBO;
-	glGenFramebuffers(1, &depthMapFBO);
-	// create depth texture
-	unsigned int depthMap;
-	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-	// attach depth texture as FBO's depth buffer
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	Model bucuresti(localPath.string() + "/Resources/stations/bucurestiMap/bucuresti.obj", false, staticModel);
+	Model brasov(localPath.string() + "/Resources/stations/brasovMap/brasov.obj", false, staticModel);
+
+	// everything placed in the world, transforms are updated every frame by UpdateSceneTransforms
+	std::vector<SceneObject> sceneObjects(SCENE_OBJECT_COUNT);
+	sceneObjects[SCENE_TRAIN].model = &driverWagon;
+	sceneObjects[SCENE_TRAIN].dynamic = true;
+	sceneObjects[SCENE_WAGONS].model = settings.wagons > 0 ? &driverWagon : nullptr;
+	sceneObjects[SCENE_WAGONS].dynamic = true;
+	sceneObjects[SCENE_WAGONS].instanced = true;
+	sceneObjects[SCENE_TERRAIN].model = &terrain;
+	sceneObjects[SCENE_BUCURESTI].model = &bucuresti;
+	sceneObjects[SCENE_BRASOV].model = &brasov;
+
+	// the wagons reuse the locomotive model and follow its path, spaced by its length along the direction it leaves the station in.
+	// one step of the scripted route gives that direction
+	const TrainPose startPose = { trainPosition, trainRotation };
+	glm::vec3 probePosition = trainPosition;
+	glm::vec3 probeRotation = trainRotation;
+	MoveTrain(probePosition, probeRotation.x, probeRotation.y, probeRotation.z);
+	const glm::vec3 trainBackward = glm::normalize(trainPosition - probePosition);
+	const glm::vec3 modelForward = glm::normalize(glm::vec3(glm::inverse(TrainTransform(startPose)) * glm::vec4(-trainBackward, 0.0f)));
+	const float wagonSpacing = TRAIN_SCALE * 2.0f * glm::dot(glm::abs(modelForward), driverWagon.bounds.GetExtents()) * 1.05f;
+	Consist consist(settings.wagons, wagonSpacing);
+	consist.Reset(startPose, trainBackward);
+	std::vector<TrainPose> wagonPoses; // filled every frame, kept to reuse its storage
+
+	// static geometry goes to the multi-draw indirect arena when the context supports it, the arena keeps the transforms it sees here.
+	// the arena packs the real textures into arrays and the texture manager measures their full size, so with streaming
+	// both are set up once every texture is in. textures moved into arrays are released and not managed
+	UpdateSceneTransforms(sceneObjects, consist, wagonPoses);
+	std::unique_ptr<IndirectRenderer> indirectRenderer;
+	auto setupLoadedTextures = [&]() {
+		if (settings.indirectDraw && GLExtensions::Instance().multiDrawIndirect)
+			indirectRenderer.reset(new IndirectRenderer(sceneObjects));
+		if (textureManager)
+			for (const SceneObject& object : sceneObjects)
+				if (object.model)
+					textureManager->Track(*object.model);
+	};
+	bool texturesPending = settings.textureStreaming;
+	if (!texturesPending)
+		setupLoadedTextures();
+
+	// cascaded shadow maps, one layer of a depth texture array per cascade
+	// --------------------------------------------------------------------
+	ShadowCascades shadowCascades(settings.shadowMapSize, settings.shadowCascades, settings.shadowCache, settings.shadowLightThreshold);
 
 	// shader configuration
 	// --------------------
 	shadowMappingShader.Use();
 	shadowMappingShader.SetInt("diffuseTexture", 0);
-	shadowMappingShader.SetInt("shadowMap", 1);
+	shadowMappingShader.SetInt("shadowMap", SHADOW_MAP_TEXTURE_UNIT);
+	shadowMappingUniformScaleShader.Use();
+	shadowMappingUniformScaleShader.SetInt("diffuseTexture", 0);
+	shadowMappingUniformScaleShader.SetInt("shadowMap", SHADOW_MAP_TEXTURE_UNIT);
+	shadowMappingInstancedShader.Use();
+	shadowMappingInstancedShader.SetInt("diffuseTexture", 0);
+	shadowMappingInstancedShader.SetInt("shadowMap", SHADOW_MAP_TEXTURE_UNIT);
+	shadowMappingIndirectShader.Use();
+	shadowMappingIndirectShader.SetInt("diffuseArray", 0);
+	shadowMappingIndirectShader.SetInt("shadowMap", SHADOW_MAP_TEXTURE_UNIT);
+	const Uniform<int> cascadeIndexUniform = shadowMappingDepthShader.GetUniform<int>("cascadeIndex");
+	const Uniform<int> instancedCascadeIndexUniform = shadowMappingDepthInstancedShader.GetUniform<int>("cascadeIndex");
 
 	std::vector<std::string> daySkybox
 	{
@@ -258,20 +367,74 @@ int main()
 		textureFolder + "/front2.jpg",
 		textureFolder + "/back2.jpg"
 	};
-	unsigned int cubemapTexture = LoadCubemap(daySkybox);
+
+	// both skyboxes are loaded once, skybox.fs blends between them so changing the time of day never reads the disk
+	CubemapCache cubemaps;
+	const unsigned int dayCubemap = cubemaps.Get(daySkybox);
+	const unsigned int sunsetCubemap = cubemaps.Get(sunsetSkybox);
 
 	skyboxShader.Use();
 	skyboxShader.SetInt("skybox", 0);
-
-	// lighting info
-	float ambientStrength = 0.7f;
-	float specularStrength = 2.1f;
-	float diffuseStrength = 2.0f;
+	skyboxShader.SetInt("sunsetSkybox", 1);
+	const Uniform<float> dayBlendUniform = skyboxShader.GetUniform<float>("dayBlend");
+
+	// per-frame and per-object uniform blocks, shared by every program, and the instance matrices of every pass
+	const size_t instanceBytes = (MAX_SHADOW_CASCADES + 1) * (settings.wagons * sizeof(glm::mat4) + 256);
+	UniformRing uniformRing(sizeof(PerFrameBlock) + sceneObjects.size() * 256 + instanceBytes + 1024);
+	std::vector<size_t> objectOffsets(sceneObjects.size());
+
+	// draw packets of the frame and the programs each pass uses for every shader variant
+	RenderQueue renderQueue;
+	Shader* depthPassShaders[SHADER_VARIANT_COUNT] = { &shadowMappingDepthShader, &shadowMappingDepthShader, &shadowMappingDepthInstancedShader,
+		&shadowMappingDepthInstancedShader };
+	Shader* depthPrepassShaders[SHADER_VARIANT_COUNT] = { &depthPrepassShader, &depthPrepassShader, &depthPrepassInstancedShader,
+		&depthPrepassInstancedShader };
+	Shader* mainPassShaders[SHADER_VARIANT_COUNT] = { &shadowMappingShader, &shadowMappingUniformScaleShader, &shadowMappingInstancedShader,
+		&shadowMappingIndirectShader };
+	// one view per shadow cascade, then the camera
+	std::vector<PassView> passViews(shadowCascades.GetCascadeCount() + 1);
+	// submits the packets of a pass, the arena ones through the indirect renderer with the INDIRECT program of the pass
+	auto submitPass = [&](ERenderPass pass, Shader* const (&shaders)[SHADER_VARIANT_COUNT], bool bindMaterials, EDrawFilter filter) {
+		renderQueue.Submit(pass, shaders, uniformRing, bindMaterials, filter);
+		if (indirectRenderer && (filter & DRAW_INDIRECT))
+			indirectRenderer->Submit(pass, *shaders[SHADER_VARIANT_INDIRECT], bindMaterials);
+	};
+	CullingStats cullingStats;
+
+	// occlusion culling against the depth of the previous frames, and the statistics overlay
+	HiZBuffer hiZBuffer(SCR_WIDTH, SCR_HEIGHT);
+	bool occlusionCullingActive = occlusionCulling;
+	StatsOverlay statsOverlay(SCR_WIDTH, SCR_HEIGHT);
+	// GPU cost of the depth pre-pass and of the main pass, the main pass is measured separately with and without pre-pass
+	GpuPassProfiler prepassProfiler;
+	GpuPassProfiler shadingProfilers[2];
+	std::string statsText;
+	float lastStatsTime = 0.0f;
+
+	// lighting info, keys 4 and 5 move the time of day towards day or sunset over a few seconds
+	struct Lighting {
+		float ambient;
+		float diffuse;
+		float specular;
+	};
+	const Lighting dayLighting = { 0.7f, 2.0f, 2.1f };
+	const Lighting sunsetLighting = { 0.2f, 1.4f, 1.0f };
+	constexpr float DAY_TRANSITION_SECONDS = 3.0f;
+	float dayBlend = 1.0f;  // 1 for day, 0 for sunset
+	float dayTarget = 1.0f;
+	float ambientStrength = dayLighting.ambient;
+	float specularStrength = dayLighting.specular;
+	float diffuseStrength = dayLighting.diffuse;
 
 	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), static_cast<void*>(nullptr));
 	glEnableVertexAttribArray(0);
 
+	// compare cold (compiled) and warm (cached) shader startup
+	const Shader::BuildStats& shaderStats = Shader::GetBuildStats();
+	std::cout << "Built " << shaderStats.compiled + shaderStats.fromCache << " programs in " << shaderStats.milliseconds << " ms, "
+		<< shaderStats.fromCache << " from the program cache" << (GLExtensions::Instance().programBinary ? "" : " (not supported by the driver)") << std::endl;
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
@@ -301,27 +464,86 @@ int main()
 
 		// 1. render depth of scene to texture (from light's perspective)
 		// --------------------------------------------------------------
-		glm::mat4 lightProjection, lightView;
-		glm::mat4 lightSpaceMatrix;
-		float near_plane = 1.0f, far_plane = 7.5f;
-
 		glm::mat4 lightRotationMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(rotationAngleInDegrees), rotationAxis);
 		glm::vec4 rotatedLightPos = lightRotationMatrix * glm::vec4(lightPos, 1.0f);
 		glm::vec3 finalLightPos = glm::vec3(rotatedLightPos);
-		lightView = glm::lookAt(finalLightPos, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-
-		lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-		lightSpaceMatrix = lightProjection * lightView;
 
-		// render scene from light's point of view
-		shadowMappingDepthShader.Use();
-		shadowMappingDepthShader.SetMat4("lightSpaceMatrix", lightSpaceMatrix);
+		// fit the cascades to the camera frustum, their depth range has to reach every shadow caster
+		UpdateSceneTransforms(sceneObjects, consist, wagonPoses);
+		if (textureStreamer)
+		{
+			textureStreamer->Update();
+			if (texturesPending && textureStreamer->IsIdle())
+			{
+				setupLoadedTextures();
+				texturesPending = false;
+			}
+		}
+		AABB casterBounds;
+		for (const SceneObject& object : sceneObjects)
+			if (object.model && (object.passMask & RENDER_PASS_SHADOW))
+				casterBounds.Expand(object.GetWorldBounds());
+		shadowCascades.Update(view, glm::radians(camera.Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT),
+			0.1f, settings.shadowDistance, finalLightPos, casterBounds);
+
+		// write this frame's uniform blocks once, every pass and program reads them from the ring
+		uniformRing.BeginFrame();
+		PerFrameBlock frameBlock = {};
+		frameBlock.projection = projection;
+		frameBlock.view = view;
+		shadowCascades.FillFrameBlock(frameBlock);
+		frameBlock.viewPos = camera.Position;
+		frameBlock.lightPos = lightPos;
+		frameBlock.ambientStrength = ambientStrength;
+		frameBlock.diffuseStrength = diffuseStrength;
+		frameBlock.specularStrength = specularStrength;
+		const size_t frameOffset = uniformRing.Write(&frameBlock, sizeof(PerFrameBlock));
+
+		for (size_t i = 0; i < sceneObjects.size(); i++)
+		{
+			PerObjectBlock objectBlock = MakePerObjectBlock(sceneObjects[i].transform);
+			objectOffsets[i] = uniformRing.Write(&objectBlock, sizeof(PerObjectBlock));
+		}
 
-		glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		RenderScene(shadowMappingDepthShader, driverWagon, terrain, brasov, bucuresti);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		// cull against every cascade and the camera frustum, then build and sort the draw packets once, every pass submits them
+		for (unsigned int cascade = 0; cascade < shadowCascades.GetCascadeCount(); cascade++)
+			passViews[cascade] = { GetCascadePass(cascade), shadowCascades.GetMatrix(cascade) };
+		passViews.back() = { RENDER_PASS_MAIN, projection * view };
+		// the Hi-Z buffer also removes main pass submeshes hidden behind what was drawn the previous frames
+		if (occlusionCulling && !occlusionCullingActive)
+			hiZBuffer.Invalidate();
+		occlusionCullingActive = occlusionCulling;
+		if (textureManager)
+			textureManager->BeginFrame(static_cast<float>(SCR_HEIGHT) / (2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f)));
+		RenderScene(renderQueue, uniformRing, sceneObjects, objectOffsets, camera.Position, passViews, occlusionCulling ? &hiZBuffer : nullptr, cullingStats,
+			textureManager.get());
+		if (textureManager)
+			textureManager->Update();
+		if (indirectRenderer)
+			indirectRenderer->Build(renderQueue);
+		// culling wrote the instance matrices of every pass, the slice is complete
+		uniformRing.Flush();
+		if (frameOffset != UniformRing::INVALID_OFFSET)
+			uniformRing.Bind(PER_FRAME_BINDING, frameOffset, sizeof(PerFrameBlock));
+
+		// render scene from light's point of view, every cascade only gets the casters inside its own bounds.
+		// static casters are only drawn when the cached layer of the cascade is stale, the train every frame
+		for (unsigned int cascade = 0; cascade < shadowCascades.GetCascadeCount(); cascade++)
+		{
+			shadowMappingDepthInstancedShader.Use();
+			shadowMappingDepthInstancedShader.Set(instancedCascadeIndexUniform, static_cast<int>(cascade));
+			shadowMappingDepthShader.Use();
+			shadowMappingDepthShader.Set(cascadeIndexUniform, static_cast<int>(cascade));
+			if (shadowCascades.NeedsStaticRebuild(cascade))
+			{
+				shadowCascades.BeginStaticCascade(cascade);
+				submitPass(GetCascadePass(cascade), depthPassShaders, false, DRAW_ALL_STATIC);
+				shadowCascades.EndStaticCascade(cascade);
+			}
+			shadowCascades.BeginCascade(cascade);
+			submitPass(GetCascadePass(cascade), depthPassShaders, false, DRAW_DYNAMIC);
+		}
+		shadowCascades.End();
 
 		// reset viewport
 		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
@@ -331,40 +553,52 @@ int main()
 		// --------------------------------------------------------------
 		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		shadowMappingShader.Use();
-		shadowMappingShader.SetMat4("projection", projection);
-		shadowMappingShader.SetMat4("view", view);
-		// set light uniforms
-		shadowMappingShader.SetVec3("viewPos", camera.Position);
-		shadowMappingShader.SetVec3("lightPos", lightPos);
-		shadowMappingShader.SetMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-		shadowMappingShader.SetFloat("ambientStrength", ambientStrength);
-		shadowMappingShader.SetFloat("specularStrength", specularStrength);
-		shadowMappingShader.SetFloat("diffuseStrength", diffuseStrength);
-		glBindTexture(GL_TEXTURE_2D, depthMap);
-		RenderScene(shadowMappingShader, driverWagon, terrain, brasov, bucuresti);
+		shadowCascades.BindTexture();
+		if (depthPrepass)
+		{
+			// depth only first, then every pixel is shaded once by the fragment that ends up visible
+			prepassProfiler.Begin();
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			submitPass(RENDER_PASS_MAIN, depthPrepassShaders, false, DRAW_ALL);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			prepassProfiler.End();
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
+		GpuPassProfiler& shadingProfiler = shadingProfilers[depthPrepass ? 1 : 0];
+		shadingProfiler.Begin();
+		submitPass(RENDER_PASS_MAIN, mainPassShaders, true, DRAW_ALL);
+		shadingProfiler.End();
+		if (depthPrepass)
+		{
+			glDepthMask(GL_TRUE);
+			glDepthFunc(GL_LESS);
+		}
+
+		// capture the depth of the opaque scene for the occlusion test of the next frames
+		if (occlusionCulling)
+			hiZBuffer.Update(projection * view);
 
 		if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) // day
 		{
-			cubemapTexture = LoadCubemap(daySkybox);
-			ambientStrength = 0.7f;
-			specularStrength = 2.1f;
-			diffuseStrength = 2.0f;
+			dayTarget = 1.0f;
 			isDay = true;
 		}
 		if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) // night
 		{
-			cubemapTexture = LoadCubemap(sunsetSkybox);
-			specularStrength = 1.0f;
-			diffuseStrength = 1.4f;
-			ambientStrength = 0.2f;
+			dayTarget = 0.0f;
 			isDay = false;
 		}
+		const float dayStep = deltaTime / DAY_TRANSITION_SECONDS;
+		dayBlend = dayBlend < dayTarget ? std::min(dayBlend + dayStep, dayTarget) : std::max(dayBlend - dayStep, dayTarget);
+		ambientStrength = glm::mix(sunsetLighting.ambient, dayLighting.ambient, dayBlend);
+		diffuseStrength = glm::mix(sunsetLighting.diffuse, dayLighting.diffuse, dayBlend);
+		specularStrength = glm::mix(sunsetLighting.specular, dayLighting.specular, dayBlend);
 		if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
 		{
 			trainPosition = { 1373.0f, -231.5f, -1482.0f };
 			trainRotation = { 0.0f, 315.3f, 0.0f };
+			consist.Reset(startPose, trainBackward);
 		}
 
 		switch (cameraType)
@@ -428,16 +662,32 @@ int main()
 		glDepthFunc(GL_LEQUAL);
 		// change depth function so depth test passes when values are equal to depth buffer's content
 		skyboxShader.Use();
-		view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-		skyboxShader.SetMat4("view", view);
-		skyboxShader.SetMat4("projection", projection);
+		skyboxShader.Set(dayBlendUniform, dayBlend);
 		// skybox cube
 		glBindVertexArray(skyboxVAO);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, sunsetCubemap);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, dayCubemap);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
 		glBindVertexArray(0);
 		glDepthFunc(GL_LESS); // set depth function back to default
 
+		// statistics, the text is refreshed a few times per second so it stays readable
+		if (showRenderStats)
+		{
+			if (currentFrame - lastStatsTime >= 0.25f)
+			{
+				statsText = FormatRenderStats(deltaTime, renderQueue, passViews, cullingStats, shadowCascades.TakeStaticRebuildCount(),
+					prepassProfiler, shadingProfilers, textureManager.get());
+				lastStatsTime = currentFrame;
+			}
+			statsOverlay.Draw(statsText);
+		}
+
+		// the GPU may reuse this frame's uniform slice once everything above is done
+		uniformRing.EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
@@ -538,84 +788,228 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	if (glfwGetKey(window, GLFW_KEY_KP_SUBTRACT) == GLFW_PRESS) // decrease volume
 		if (volume > 0.0f)
 			volume -= 0.1f;
+	if (key == GLFW_KEY_F3 && action == GLFW_PRESS) // toggle render statistics
+		showRenderStats = !showRenderStats;
+	if (key == GLFW_KEY_F4 && action == GLFW_PRESS) // toggle occlusion culling
+		occlusionCulling = !occlusionCulling;
+	if (key == GLFW_KEY_F5 && action == GLFW_PRESS) // toggle depth pre-pass
+		depthPrepass = !depthPrepass;
 }
 
-// loads a cubemap texture from 6 individual texture faces
-// order:
-// +X (right)
-// -X (left)
-// +Y (top)
-// -Y (bottom)
-// +Z (front) 
-// -Z (back)
-// skybox
-// -------------------------------------------------------
-unsigned int LoadCubemap(std::vector<std::string> faces)
+glm::mat4 TrainTransform(const TrainPose& pose)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-	int width, height, nrChannels;
-	for (unsigned int i = 0; i < faces.size(); i++)
-	{
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE,
-				data);
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
-		}
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	return textureID;
+	auto train = glm::mat4(1.0f);
+	train = translate(train, pose.position);
+	train = scale(train, glm::vec3(TRAIN_SCALE, TRAIN_SCALE, TRAIN_SCALE));
+	train = glm::rotate(train, glm::radians(pose.rotation.x), glm::vec3(1, 0, 0));
+	train = glm::rotate(train, glm::radians(pose.rotation.y), glm::vec3(0, 1, 0));
+	train = glm::rotate(train, glm::radians(pose.rotation.z), glm::vec3(0, 0, 1));
+	return train;
 }
 
-void RenderScene(Shader& shader, Model& driverWagon, Model& terrain, Model& brasov, Model& bucharest)
+void UpdateSceneTransforms(std::vector<SceneObject>& objects, Consist& consist, std::vector<TrainPose>& wagonPoses)
 {
-	// render the loaded model
-	auto train = glm::mat4(1.0f);
-	auto _terrain = glm::mat4(1.0f);
-	auto _bucuresti = glm::mat4(1.0f);
-	auto _brasov = glm::mat4(1.0f);
+	// the train used to advance once per RenderScene call (shadow + main pass), keep that pace now that it moves once per frame
+	if (isMoving)
+	{
+		MoveTrain(trainPosition, trainRotation.x, trainRotation.y, trainRotation.z);
+		consist.Advance({ trainPosition, trainRotation });
+		MoveTrain(trainPosition, trainRotation.x, trainRotation.y, trainRotation.z);
+		consist.Advance({ trainPosition, trainRotation });
+	}
 
-	train = (isMoving ? translate(train, MoveTrain(trainPosition, trainRotation.x, trainRotation.y, trainRotation.z)) : translate(train, trainPosition));
+	// train
+	objects[SCENE_TRAIN].transform = TrainTransform({ trainPosition, trainRotation });
 
-	train = scale(train, glm::vec3(10.0f, 10.0f, 10.0f));
-	train = glm::rotate(train, glm::radians(trainRotation.x), glm::vec3(1, 0, 0));
-	train = glm::rotate(train, glm::radians(trainRotation.y), glm::vec3(0, 1, 0));
-	train = glm::rotate(train, glm::radians(trainRotation.z), glm::vec3(0, 0, 1));
-	shader.SetMat4("model", train);
-	driverWagon.Draw(shader);
+	// wagons
+	consist.GetWagonPoses(wagonPoses);
+	std::vector<glm::mat4>& wagons = objects[SCENE_WAGONS].instances;
+	wagons.clear();
+	for (const TrainPose& pose : wagonPoses)
+		wagons.push_back(TrainTransform(pose));
 
 	// terrain
+	auto _terrain = glm::mat4(1.0f);
 	_terrain = translate(_terrain, glm::vec3(-80.0f, -350.0f, 1000.0f));
 	_terrain = scale(_terrain, glm::vec3(250.0f, 250.0f, 250.0f));
-	shader.SetMat4("model", _terrain);
-	terrain.Draw(shader);
+	objects[SCENE_TERRAIN].transform = _terrain;
 
 	// bucuresti
+	auto _bucuresti = glm::mat4(1.0f);
 	_bucuresti = translate(_bucuresti, glm::vec3(800.0f, -300.0f, -930.0f));
 	_bucuresti = scale(_bucuresti, glm::vec3(150.0f, 150.0f, 150.0f));
-	shader.SetMat4("model", _bucuresti);
-	bucharest.Draw(shader);
+	objects[SCENE_BUCURESTI].transform = _bucuresti;
 
 	// brasov
+	auto _brasov = glm::mat4(1.0f);
 	_brasov = translate(_brasov, glm::vec3(-3550.0f, -210.0f, -350.0f));
 	_brasov = scale(_brasov, glm::vec3(50.0f, 50.0f, 50.0f));
 	_brasov = glm::rotate(_brasov, glm::radians(-75.0f), glm::vec3(0, 1, 0));
-	shader.SetMat4("model", _brasov);
-	brasov.Draw(shader);
+	objects[SCENE_BRASOV].transform = _brasov;
+}
+
+void RenderScene(RenderQueue& queue, UniformRing& ring, const std::vector<SceneObject>& objects, const std::vector<size_t>& objectOffsets, const glm::vec3& viewPos, const std::vector<PassView>& passViews, const HiZBuffer* occlusion, CullingStats& stats,
+	TextureManager* textures)
+{
+	// describe the frame as draw packets, every pass submits the same sorted queue.
+	// each pass only gets the submeshes inside its own frustum, found through the BVH of the model.
+	// objects with uniform scale use the shader variant that doesn't need the normal matrix
+	queue.Clear();
+	stats.Reset(passViews.size());
+	std::vector<unsigned int> subMeshPasses;
+	std::vector<glm::mat4> visibleInstances;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		const SceneObject& object = objects[i];
+		// objects whose PerObject block didn't fit in the uniform ring are not drawn this frame
+		if (!object.model || object.passMask == 0 || objectOffsets[i] == UniformRing::INVALID_OFFSET)
+			continue;
+		const unsigned int subMeshCount = object.model->GetSubMeshCount();
+
+		// instances are culled whole, every pass writes the matrices of its visible instances to the ring and draws
+		// them with one call per mesh
+		if (object.instanced)
+		{
+			const unsigned int instanceCount = static_cast<unsigned int>(object.instances.size());
+			stats.subMeshCount += subMeshCount * instanceCount;
+			const float depth = glm::distance(viewPos, object.GetWorldBounds().GetCenter());
+			for (size_t view = 0; view < passViews.size(); view++)
+			{
+				const ERenderPass pass = passViews[view].pass;
+				if ((object.passMask & pass) == 0)
+					continue;
+				const Frustum frustum(passViews[view].viewProjection);
+				const bool testOcclusion = pass == RENDER_PASS_MAIN && occlusion && occlusion->IsReady();
+				unsigned int inFrustum = 0;
+				visibleInstances.clear();
+				for (const glm::mat4& instance : object.instances)
+				{
+					const AABB bounds = object.model->bounds.Transform(instance);
+					if (!frustum.Intersects(bounds))
+						continue;
+					inFrustum++;
+					if (testOcclusion && occlusion->IsOccluded(bounds))
+						stats.occluded += subMeshCount;
+					else
+						visibleInstances.push_back(instance);
+				}
+				stats.visible[view] += subMeshCount * inFrustum;
+				stats.culled[view] += subMeshCount * (instanceCount - inFrustum);
+				if (visibleInstances.empty())
+					continue;
+
+				// the texture manager sizes the textures by the whole set of instances
+				if (textures && pass == RENDER_PASS_MAIN)
+					for (const Mesh& mesh : object.model->meshes)
+						for (const SubMesh& subMesh : mesh.subMeshes)
+							textures->MarkUsed(subMesh.textures, object.GetWorldBounds(), viewPos);
+
+				const size_t instanceOffset = ring.Write(visibleInstances.data(), visibleInstances.size() * sizeof(glm::mat4));
+				if (instanceOffset == UniformRing::INVALID_OFFSET)
+					continue;
+				subMeshPasses.assign(subMeshCount, pass);
+				queue.AddModel(*object.model, objectOffsets[i], subMeshPasses, SHADER_VARIANT_INSTANCED, object.GetDrawClass(), depth,
+					instanceOffset, static_cast<unsigned int>(visibleInstances.size()));
+			}
+			continue;
+		}
+
+		subMeshPasses.assign(subMeshCount, 0);
+		stats.subMeshCount += subMeshCount;
+		for (size_t view = 0; view < passViews.size(); view++)
+		{
+			if ((object.passMask & passViews[view].pass) == 0)
+				continue;
+			// testing model space bounds against the frustum of viewProjection * model avoids transforming every box
+			const Frustum frustum(passViews[view].viewProjection * object.transform);
+			const unsigned int visible = object.model->Cull(frustum, passViews[view].pass, subMeshPasses);
+			stats.visible[view] += visible;
+			stats.culled[view] += subMeshCount - visible;
+		}
+
+		// the main pass skips submeshes the Hi-Z buffer says are hidden, the shadow pass still needs them as casters
+		if (occlusion && occlusion->IsReady() && (object.passMask & RENDER_PASS_MAIN))
+		{
+			const Model& model = *object.model;
+			const bool objectOccluded = occlusion->IsOccluded(model.bounds.Transform(object.transform));
+			for (size_t mesh = 0; mesh < model.meshes.size(); mesh++)
+			{
+				for (size_t subMesh = 0; subMesh < model.meshes[mesh].subMeshes.size(); subMesh++)
+				{
+					unsigned int& passes = subMeshPasses[model.GetSubMeshIndex(mesh, subMesh)];
+					if ((passes & RENDER_PASS_MAIN) == 0)
+						continue;
+					if (objectOccluded || occlusion->IsOccluded(model.meshes[mesh].subMeshes[subMesh].bounds.Transform(object.transform)))
+					{
+						passes &= ~RENDER_PASS_MAIN;
+						stats.occluded++;
+					}
+				}
+			}
+		}
+
+		// the textures drawn by the main pass, with how large their submeshes are on screen
+		if (textures)
+		{
+			const Model& model = *object.model;
+			for (size_t mesh = 0; mesh < model.meshes.size(); mesh++)
+			{
+				for (size_t subMesh = 0; subMesh < model.meshes[mesh].subMeshes.size(); subMesh++)
+				{
+					const SubMesh& range = model.meshes[mesh].subMeshes[subMesh];
+					if (!range.textures.empty() && (subMeshPasses[model.GetSubMeshIndex(mesh, subMesh)] & RENDER_PASS_MAIN))
+						textures->MarkUsed(range.textures, range.bounds.Transform(object.transform), viewPos);
+				}
+			}
+		}
+
+		const unsigned int variant = HasUniformScale(object.transform) ? SHADER_VARIANT_UNIFORM_SCALE : SHADER_VARIANT_DEFAULT;
+		const float depth = glm::distance(viewPos, object.model->bounds.Transform(object.transform).GetCenter());
+		queue.AddModel(*object.model, objectOffsets[i], subMeshPasses, variant, object.GetDrawClass(), depth);
+	}
+	queue.Sort();
+}
+
+std::string FormatRenderStats(float frameTime, const RenderQueue& queue, const std::vector<PassView>& passViews, const CullingStats& stats, unsigned int staticShadowRebuilds,
+	const GpuPassProfiler& prepassProfiler, const GpuPassProfiler (&shadingProfilers)[2], const TextureManager* textures)
+{
+	static const char* cameraNames[] = { "free", "outside", "driver" }; // in CameraType order
+	std::ostringstream text;
+	text.setf(std::ios::fixed);
+	text.precision(2);
+	text << "frame " << frameTime * 1000.0f << " ms (" << (frameTime > 0.0f ? 1.0f / frameTime : 0.0f) << " fps), "
+		<< cameraNames[static_cast<int>(cameraType)] << " camera\n";
+	text << "packets " << queue.GetPackets().size() << ", submeshes " << stats.subMeshCount << "\n";
+	for (size_t view = 0; view < passViews.size(); view++)
+	{
+		if (passViews[view].pass == RENDER_PASS_MAIN)
+			text << "main: ";
+		else
+			text << "cascade " << view << ": ";
+		text << stats.visible[view] << " in frustum, " << stats.culled[view] << " culled\n";
+	}
+	text << "occluded: " << stats.occluded << (occlusionCulling ? "" : " (occlusion culling off)") << "\n";
+	text << "static shadow layers redrawn since last update: " << staticShadowRebuilds << "\n";
+
+	// main pass cost in both modes, the mode that is off keeps its last measurement for comparison
+	const GpuPassProfiler& withoutPrepass = shadingProfilers[0];
+	const GpuPassProfiler& withPrepass = shadingProfilers[1];
+	text << "depth pre-pass " << (depthPrepass ? "on" : "off") << "\n";
+	if (withoutPrepass.HasResult())
+		text << "shading without pre-pass: " << withoutPrepass.GetMilliseconds() << " ms, " << withoutPrepass.GetSamplesPassed() << " fragments\n";
+	if (withPrepass.HasResult())
+		text << "shading with pre-pass: " << withPrepass.GetMilliseconds() << " ms + " << prepassProfiler.GetMilliseconds() << " ms depth, "
+			<< withPrepass.GetSamplesPassed() << " fragments\n";
+	if (withoutPrepass.HasResult() && withPrepass.HasResult() && withoutPrepass.GetSamplesPassed() > 0)
+	{
+		const double shaded = static_cast<double>(withPrepass.GetSamplesPassed()) / withoutPrepass.GetSamplesPassed();
+		text << "pre-pass saves " << (1.0 - shaded) * 100.0 << "% of shaded fragments, "
+			<< withoutPrepass.GetMilliseconds() - withPrepass.GetMilliseconds() - prepassProfiler.GetMilliseconds() << " ms\n";
+	}
+	if (textures)
+		text << "textures: " << textures->GetResidentBytes() / (1024.0 * 1024.0) << " of " << textures->GetBudgetBytes() / (1024.0 * 1024.0) << " MB, "
+			<< textures->GetDowngradedCount() << " of " << textures->GetTextureCount() << " without their top mips\n";
+	return text.str();
 }
 
 glm::vec3 MoveTrain(glm::vec3& trainPosition, float& degreesX, float& degreesY, float& degreesZ) {
@@ -949,7 +1343,10 @@ void Menu()
 		"<4> Day Mode\n"
 		"<5> Night Mode\n"
 		"<+> Increase train speed\n"
-		"<-> Decrease train speed\n";
+		"<-> Decrease train speed\n"
+		"<F3> Show render statistics\n"
+		"<F4> Toggle occlusion culling\n"
+		"<F5> Toggle depth pre-pass\n";
 }
 
 void PlaySounds()
@@ -0,0 +1,127 @@
+#include "UniformBlocks.h"
+
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	struct BlockBinding {
+		const char* name;
+		EUniformBlockBinding binding;
+	};
+
+	const BlockBinding BLOCK_BINDINGS[] = {
+		{ "PerFrame", PER_FRAME_BINDING },
+		{ "PerObject", PER_OBJECT_BINDING }
+	};
+}
+
+void BindUniformBlocks(unsigned int program)
+{
+	for (const BlockBinding& block : BLOCK_BINDINGS)
+	{
+		GLuint index = glGetUniformBlockIndex(program, block.name);
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, block.binding);
+	}
+}
+
+bool HasUniformScale(const glm::mat4& model)
+{
+	const glm::mat3 basis(model);
+	const float x = glm::dot(basis[0], basis[0]);
+	const float y = glm::dot(basis[1], basis[1]);
+	const float z = glm::dot(basis[2], basis[2]);
+	const float tolerance = 1e-4f * std::max(x, std::max(y, z));
+	// equal axis lengths are not enough with shear, the axes also have to stay orthogonal
+	return std::abs(x - y) <= tolerance && std::abs(x - z) <= tolerance &&
+		std::abs(glm::dot(basis[0], basis[1])) <= tolerance &&
+		std::abs(glm::dot(basis[0], basis[2])) <= tolerance &&
+		std::abs(glm::dot(basis[1], basis[2])) <= tolerance;
+}
+
+PerObjectBlock MakePerObjectBlock(const glm::mat4& model)
+{
+	PerObjectBlock block;
+	block.model = model;
+	block.normalMatrix = HasUniformScale(model) ? glm::mat4(glm::mat3(model)) : glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+	return block;
+}
+
+UniformRing::UniformRing(size_t bytesPerFrame, unsigned int framesInFlight) :
+	frame(0), writeOffset(0), mapped(nullptr), fences(framesInFlight, nullptr)
+{
+	GLint offsetAlignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	alignment = static_cast<size_t>(offsetAlignment);
+	sliceSize = AlignUp(bytesPerFrame, alignment);
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sliceSize * framesInFlight, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+UniformRing::~UniformRing()
+{
+	for (GLsync fence : fences)
+		if (fence)
+			glDeleteSync(fence);
+	glDeleteBuffers(1, &buffer);
+}
+
+void UniformRing::BeginFrame()
+{
+	frame = (frame + 1) % fences.size();
+	writeOffset = 0;
+
+	// the slice was last used framesInFlight frames ago, this normally returns immediately
+	if (fences[frame])
+	{
+		glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fences[frame]);
+		fences[frame] = nullptr;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, frame * sliceSize, sliceSize,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+size_t UniformRing::Write(const void* data, size_t size)
+{
+	const size_t offset = AlignUp(writeOffset, alignment);
+	if (!mapped || offset + size > sliceSize)
+	{
+		std::cout << "ERROR::UNIFORM_RING:: frame slice of " << sliceSize << " bytes is full" << std::endl;
+		return INVALID_OFFSET;
+	}
+	std::memcpy(mapped + offset, data, size);
+	writeOffset = offset + size;
+	return frame * sliceSize + offset;
+}
+
+void UniformRing::Flush()
+{
+	if (!mapped)
+		return;
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	mapped = nullptr;
+}
+
+void UniformRing::EndFrame()
+{
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformRing::Bind(unsigned int binding, size_t offset, size_t size) const
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+}
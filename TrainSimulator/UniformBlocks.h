@@ -0,0 +1,97 @@
+#pragma once
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// binding points of the uniform blocks shared by every program, Shader binds the blocks it finds by name
+enum EUniformBlockBinding : unsigned int {
+	PER_FRAME_BINDING = 0,
+	PER_OBJECT_BINDING = 1
+};
+
+// size of the lightSpaceMatrices array of PerFrame, the most shadow cascades the shaders support
+const unsigned int MAX_SHADOW_CASCADES = 4;
+
+// std140 mirror of "uniform PerFrame", written once per frame
+struct PerFrameBlock {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::mat4 lightSpaceMatrices[MAX_SHADOW_CASCADES];
+	glm::vec4 cascadeSplits;
+	glm::vec3 viewPos;
+	float     ambientStrength;
+	glm::vec3 lightPos;
+	float     diffuseStrength;
+	float     specularStrength;
+	int       cascadeCount;
+	float     padding[2];
+};
+static_assert(sizeof(PerFrameBlock) == 448, "PerFrameBlock must match the std140 layout of PerFrame");
+
+// std140 mirror of "uniform PerObject", one per drawn object per frame
+struct PerObjectBlock {
+	glm::mat4 model;
+	glm::mat4 normalMatrix; // transpose(inverse(mat3(model))) in the upper 3x3, a mat4 to avoid std140 mat3 padding
+};
+static_assert(sizeof(PerObjectBlock) == 128, "PerObjectBlock must match the std140 layout of PerObject");
+
+// true when the model matrix scales every axis by the same amount, then mat3(model) transforms normals correctly
+// (up to length, which the fragment shader normalizes) and the UNIFORM_SCALE shader variant can skip the normal matrix
+bool HasUniformScale(const glm::mat4& model);
+
+// fills a PerObject block, the normal matrix is only inverted for objects that need it
+PerObjectBlock MakePerObjectBlock(const glm::mat4& model);
+
+// binds every known uniform block declared by the program to its binding point
+void BindUniformBlocks(unsigned int program);
+
+// A uniform buffer split into one slice per frame in flight.
+// Each frame maps its slice once (unsynchronized, the fence of the slice guarantees the GPU is done with it),
+// appends every block it needs, then binds ranges of the buffer while drawing.
+class UniformRing
+{
+public:
+	// returned by Write when the block doesn't fit in the slice, never a valid offset
+	static const size_t INVALID_OFFSET = static_cast<size_t>(-1);
+
+	UniformRing(size_t bytesPerFrame, unsigned int framesInFlight = 3);
+	~UniformRing();
+
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	// waits until the GPU is done with the next slice and maps it for writing
+	void BeginFrame();
+
+	// copies a block into the current slice, returns its offset in the buffer or INVALID_OFFSET when the slice is full
+	// (the caller must skip the draws reading it)
+	size_t Write(const void* data, size_t size);
+
+	// unmaps the current slice, must be called before drawing with the written blocks
+	void Flush();
+
+	// fences the current slice, call once all draws reading it are submitted
+	void EndFrame();
+
+	// binds [offset, offset + size) to a uniform block binding point
+	void Bind(unsigned int binding, size_t offset, size_t size) const;
+
+	// the buffer object itself, per-instance matrices stream through the same ring and are read as vertex attributes
+	unsigned int GetBuffer() const { return buffer; }
+
+private:
+	unsigned int buffer;
+	size_t sliceSize;
+	size_t alignment;
+	unsigned int frame;
+	size_t writeOffset;
+	unsigned char* mapped;
+	std::vector<GLsync> fences;
+};
+
+#endif
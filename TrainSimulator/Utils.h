@@ -0,0 +1,33 @@
+#pragma once
+#ifndef UTILS_H
+#define UTILS_H
+
+#include <chrono>
+#include <cstdint>
+
+// 64-bit FNV-1a hash of size bytes, pass the previous result as hash to continue hashing
+inline uint64_t Fnv1a(const void* data, uint64_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (uint64_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// rounds value up to the next multiple of alignment
+template <typename T>
+T AlignUp(T value, T alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// wall clock time elapsed since start
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
@@ -0,0 +1,234 @@
+#include "VertexLayout.h"
+
+#include <glad/glad.h>
+#include <gtc/packing.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    const unsigned int FLOAT3_SIZE = 3 * sizeof(float);
+    const unsigned int FLOAT2_SIZE = 2 * sizeof(float);
+    const unsigned int PACKED_SIZE = sizeof(uint32_t);
+
+    uint32_t PackDirection(const glm::vec3& direction)
+    {
+        float length = glm::length(direction);
+        glm::vec3 unit = length > 0.0f ? direction / length : glm::vec3(0.0f);
+        return glm::packSnorm3x10_1x2(glm::vec4(unit, 0.0f));
+    }
+
+    unsigned char* Write(unsigned char* out, const void* value, size_t size)
+    {
+        std::memcpy(out, value, size);
+        return out + size;
+    }
+}
+
+VertexLayout VertexLayout::Full()
+{
+    return VertexLayout();
+}
+
+VertexLayout VertexLayout::Compact()
+{
+    VertexLayout layout;
+    layout.attributes = ATTRIB_POSITION | ATTRIB_NORMAL | ATTRIB_TEXCOORDS;
+    layout.quantizeNormals = true;
+    return layout;
+}
+
+unsigned int VertexLayout::GetStride() const
+{
+    if (IsFull())
+        return sizeof(Vertex);
+
+    const unsigned int directionSize = quantizeNormals ? PACKED_SIZE : FLOAT3_SIZE;
+    unsigned int stride = 0;
+    if (Has(ATTRIB_POSITION))
+        stride += FLOAT3_SIZE;
+    if (Has(ATTRIB_NORMAL))
+        stride += directionSize;
+    if (Has(ATTRIB_TEXCOORDS))
+        stride += quantizeTexCoords ? PACKED_SIZE : FLOAT2_SIZE;
+    if (Has(ATTRIB_TANGENT))
+        stride += directionSize;
+    if (Has(ATTRIB_BITANGENT))
+        stride += directionSize;
+    if (Has(ATTRIB_BONES))
+        stride += MAX_BONE_INFLUENCE * (sizeof(int) + sizeof(float));
+    return stride;
+}
+
+bool VertexLayout::IsFull() const
+{
+    return attributes == ATTRIB_ALL && !quantizeNormals && !quantizeTexCoords;
+}
+
+std::vector<unsigned char> VertexLayout::Pack(const std::vector<Vertex>& vertices) const
+{
+    std::vector<unsigned char> data(vertices.size() * GetStride());
+    if (IsFull())
+    {
+        if (!vertices.empty())
+            std::memcpy(data.data(), vertices.data(), data.size());
+        return data;
+    }
+
+    unsigned char* out = data.data();
+    for (const Vertex& vertex : vertices)
+    {
+        if (Has(ATTRIB_POSITION))
+            out = Write(out, &vertex.Position, FLOAT3_SIZE);
+        if (Has(ATTRIB_NORMAL))
+        {
+            if (quantizeNormals)
+            {
+                uint32_t packed = PackDirection(vertex.Normal);
+                out = Write(out, &packed, PACKED_SIZE);
+            }
+            else
+                out = Write(out, &vertex.Normal, FLOAT3_SIZE);
+        }
+        if (Has(ATTRIB_TEXCOORDS))
+        {
+            if (quantizeTexCoords)
+            {
+                uint32_t packed = glm::packHalf2x16(vertex.TexCoords);
+                out = Write(out, &packed, PACKED_SIZE);
+            }
+            else
+                out = Write(out, &vertex.TexCoords, FLOAT2_SIZE);
+        }
+        if (Has(ATTRIB_TANGENT))
+        {
+            if (quantizeNormals)
+            {
+                uint32_t packed = PackDirection(vertex.Tangent);
+                out = Write(out, &packed, PACKED_SIZE);
+            }
+            else
+                out = Write(out, &vertex.Tangent, FLOAT3_SIZE);
+        }
+        if (Has(ATTRIB_BITANGENT))
+        {
+            if (quantizeNormals)
+            {
+                uint32_t packed = PackDirection(vertex.Bitangent);
+                out = Write(out, &packed, PACKED_SIZE);
+            }
+            else
+                out = Write(out, &vertex.Bitangent, FLOAT3_SIZE);
+        }
+        if (Has(ATTRIB_BONES))
+        {
+            out = Write(out, vertex.m_BoneIDs, sizeof(vertex.m_BoneIDs));
+            out = Write(out, vertex.m_Weights, sizeof(vertex.m_Weights));
+        }
+    }
+    return data;
+}
+
+void VertexLayout::SetupAttributes() const
+{
+    const GLsizei stride = GetStride();
+    size_t offset = 0;
+
+    // the full layout is the Vertex struct itself, so use its real member offsets
+    if (IsFull())
+    {
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+        // ids
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offsetof(Vertex, m_BoneIDs));
+        // weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, m_Weights));
+        return;
+    }
+
+    // packed directions are signed normalized 10-10-10-2, read by the shader as a regular vec3
+    auto direction = [&](GLuint location) {
+        glEnableVertexAttribArray(location);
+        if (quantizeNormals)
+        {
+            glVertexAttribPointer(location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+            offset += PACKED_SIZE;
+        }
+        else
+        {
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+            offset += FLOAT3_SIZE;
+        }
+    };
+
+    if (Has(ATTRIB_POSITION))
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        offset += FLOAT3_SIZE;
+    }
+    if (Has(ATTRIB_NORMAL))
+        direction(1);
+    if (Has(ATTRIB_TEXCOORDS))
+    {
+        glEnableVertexAttribArray(2);
+        if (quantizeTexCoords)
+        {
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+            offset += PACKED_SIZE;
+        }
+        else
+        {
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+            offset += FLOAT2_SIZE;
+        }
+    }
+    if (Has(ATTRIB_TANGENT))
+        direction(3);
+    if (Has(ATTRIB_BITANGENT))
+        direction(4);
+    if (Has(ATTRIB_BONES))
+    {
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, stride, (void*)offset);
+        offset += MAX_BONE_INFLUENCE * sizeof(int);
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        offset += MAX_BONE_INFLUENCE * sizeof(float);
+    }
+}
+
+void VertexLayout::SetupInstanceAttributes(size_t offset)
+{
+    // a mat4 attribute takes one location per column
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        const GLuint location = INSTANCE_TRANSFORM_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+void VertexLayout::SetupInstanceLayers(size_t offset)
+{
+    glEnableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+    glVertexAttribPointer(INSTANCE_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)offset);
+    glVertexAttribDivisor(INSTANCE_LAYER_LOCATION, 1);
+}
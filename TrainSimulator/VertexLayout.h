@@ -0,0 +1,66 @@
+#pragma once
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "Vertex.h"
+
+#include <vector>
+
+// vertex attributes a mesh can upload, each one always uses the same shader location (the bit index)
+enum EVertexAttribute : unsigned int {
+    ATTRIB_POSITION  = 1 << 0, // location 0
+    ATTRIB_NORMAL    = 1 << 1, // location 1
+    ATTRIB_TEXCOORDS = 1 << 2, // location 2
+    ATTRIB_TANGENT   = 1 << 3, // location 3
+    ATTRIB_BITANGENT = 1 << 4, // location 4
+    ATTRIB_BONES     = 1 << 5, // locations 5 (ids) and 6 (weights)
+    ATTRIB_ALL       = (1 << 6) - 1
+};
+
+// first of the four locations (one per column) of the per-instance model matrix read by the INSTANCED shader variants
+const unsigned int INSTANCE_TRANSFORM_LOCATION = 7;
+// per-instance texture array layer (a float) read by the TEXTURE_ARRAY shader variants
+const unsigned int INSTANCE_LAYER_LOCATION = 11;
+
+// Describes how a mesh stores its vertices in the VBO.
+// The CPU side always works with the full Vertex struct; the layout decides which attributes are uploaded
+// and whether normals/tangents are packed as 10-10-10-2 signed normalized ints and texture coordinates as half floats.
+struct VertexLayout {
+    unsigned int attributes = ATTRIB_ALL;
+    bool quantizeNormals = false;   // normal, tangent and bitangent as GL_INT_2_10_10_10_REV (4 bytes instead of 12)
+    bool quantizeTexCoords = false; // texture coordinates as GL_HALF_FLOAT (4 bytes instead of 8)
+
+    // every attribute as full floats, identical to the Vertex struct (88 bytes)
+    static VertexLayout Full();
+
+    // only what ShadowMapping.vs/ShadowMappingDepth.vs read (position, normal, texture coordinates) with packed normals (24 bytes)
+    static VertexLayout Compact();
+
+    bool Has(EVertexAttribute attribute) const { return (attributes & attribute) != 0; }
+
+    bool operator==(const VertexLayout& other) const
+    {
+        return attributes == other.attributes && quantizeNormals == other.quantizeNormals && quantizeTexCoords == other.quantizeTexCoords;
+    }
+
+    // size in bytes of one packed vertex
+    unsigned int GetStride() const;
+
+    // true when the packed data is the Vertex array itself and can be uploaded as is
+    bool IsFull() const;
+
+    // converts vertices to the packed format described by this layout
+    std::vector<unsigned char> Pack(const std::vector<Vertex>& vertices) const;
+
+    // sets up the attribute pointers of the currently bound VAO for the currently bound VBO
+    void SetupAttributes() const;
+
+    // points the instance matrix locations of the currently bound VAO at tightly packed mat4s starting at offset
+    // of the currently bound VBO, advancing once per instance
+    static void SetupInstanceAttributes(size_t offset);
+
+    // points the instance layer location of the currently bound VAO at tightly packed floats of the currently bound VBO
+    static void SetupInstanceLayers(size_t offset);
+};
+
+#endif
@@ -4,8 +4,10 @@ out vec4 FragColor;
 in vec3 TexCoords;
 
 uniform samplerCube skybox;
+uniform samplerCube sunsetSkybox;
+uniform float dayBlend; // 1 shows the day sky, 0 the sunset, in between a mix of both
 
 void main()
 {    
-    FragColor = texture(skybox, TexCoords);
+    FragColor = mix(texture(sunsetSkybox, TexCoords), texture(skybox, TexCoords), dayBlend);
 }
\ No newline at end of file
@@ -3,12 +3,24 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform PerFrame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrices[4]; // one per shadow cascade
+    vec4 cascadeSplits;         // view space distance where each cascade ends
+    vec3 viewPos;
+    float ambientStrength;
+    vec3 lightPos;
+    float diffuseStrength;
+    float specularStrength;
+    int cascadeCount;
+};
 
 void main()
 {
     TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // remove translation from the view matrix
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 } 
\ No newline at end of file